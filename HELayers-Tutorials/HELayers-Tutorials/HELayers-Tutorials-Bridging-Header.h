@@ -8,6 +8,31 @@ void euclideanDistance(void);
 void tut_1_basics(void);
 void tut_2_plaintexts(void);
 void tut_3_io(void);
+void tut_4_out_of_core(void);
+void tut_5_permutation_plans(void);
+void tut_6_tensor_views(void);
+void tut_7_cow_ctile(void);
+void tut_8_multiply_accumulate(void);
+void tut_9_batched_matmul(void);
+void tut_10_transpose(void);
+void tut_11_unknown_slots(void);
+void tut_12_mask_cache(void);
+void tut_13_tree_reduction(void);
+void tut_14_lazy_rotation(void);
+void tut_15_expression_templates(void);
+void tut_16_static_dispatch(void);
+void tut_17_move_aware(void);
+void tut_18_plain_kernels(void);
+void tut_19_packing_plans(void);
+void tut_20_encoding_pipeline(void);
+void tut_21_chebyshev(void);
+void tut_22_function_approximation(void);
+void tut_23_sign_tuning(void);
+void tut_24_batched_poly_eval(void);
+void tut_25_tournament(void);
+void tut_26_sorting(void);
+void tut_27_batched_lookup(void);
+void tut_28_filter_aggregate(void);
 #ifdef __cplusplus
 }
 #endif
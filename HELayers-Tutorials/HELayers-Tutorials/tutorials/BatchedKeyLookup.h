@@ -0,0 +1,156 @@
+//
+//  BatchedKeyLookup.h
+//  HELayers-Tutorials
+//
+
+#ifndef TUTORIALS_BATCHED_KEY_LOOKUP_H
+#define TUTORIALS_BATCHED_KEY_LOOKUP_H
+
+#include <vector>
+
+#include "helayers/math/CTileTensor.h"
+#include "helayers/math/TTEncoder.h"
+#include "ParallelFor.h"
+#include "ReductionUtils.h"
+
+namespace helayers {
+
+/// @brief Looks up many encrypted keys in an encrypted table at once.
+///
+/// SQLUtils::isEqual compares one bit-decomposed key with one column at a
+/// time. Here the records and the queries are laid along the two dims of a
+/// tile tensor: the bits of the record keys are packed as [records, *], and
+/// those of the query keys as [*, queries], where * marks a duplicated dim.
+/// Every elementwise operation on them then serves all the (record, query)
+/// pairs in a tile at once. The equality of each bit is 1 - (r - q)^2, and
+/// their product is taken as a balanced tree, so a key of b bits takes
+/// 1 + ceil(log2 b) levels. The bits, and the pairs of a tree level, are
+/// processed in parallel.
+///
+/// The result is a selection mask of shape [records, queries], 1 where the
+/// record key equals the query key. lookup() uses it to fetch a value column
+/// for all the queries.
+class BatchedKeyLookup
+{
+  const HeContext& he;
+  TTEncoder enc;
+  int numBits;
+  std::vector<DimInt> tileSizes;
+
+  std::vector<CTileTensor> encryptBits(const TTShape& shape,
+                                       const std::vector<int>& keys,
+                                       int dim) const
+  {
+    std::vector<CTileTensor> res(numBits, CTileTensor(he));
+    for (int i = 0; i < numBits; ++i) {
+      std::vector<DimInt> sizes = {1, 1};
+      sizes[dim] = static_cast<DimInt>(keys.size());
+      DoubleTensor bits(sizes);
+      for (DimInt k = 0; k < (DimInt)keys.size(); ++k)
+        (dim == 0 ? bits.at(k, 0) : bits.at(0, k)) = (keys[k] >> i) & 1;
+      enc.encodeEncrypt(res[i], shape, bits);
+    }
+    return res;
+  }
+
+public:
+  /// @brief A constructor.
+  /// @param he        The HeContext.
+  /// @param numBits   The number of bits of a key.
+  /// @param tileSizes The tile sizes of the [records, queries] layout. Their
+  ///                  product must be the slot count.
+  BatchedKeyLookup(const HeContext& he,
+                   int numBits,
+                   const std::vector<DimInt>& tileSizes)
+      : he(he), enc(he), numBits(numBits), tileSizes(tileSizes)
+  {
+    always_assert(tileSizes.size() == 2 &&
+                  tileSizes[0] * tileSizes[1] == he.slotCount());
+  }
+
+  /// @brief Returns the shape of a record column, [numRecords, *].
+  TTShape getRecordShape(DimInt numRecords) const
+  {
+    TTShape res(tileSizes);
+    res.setOriginalSizes({numRecords, 1});
+    return res.getWithDuplicatedDim(1);
+  }
+
+  /// @brief Returns the shape of a query column, [*, numQueries].
+  TTShape getQueryShape(DimInt numQueries) const
+  {
+    TTShape res(tileSizes);
+    res.setOriginalSizes({1, numQueries});
+    return res.getWithDuplicatedDim(0);
+  }
+
+  /// @brief Returns the multiplication depth of isEqual().
+  int getMulDepth() const { return 1 + ceilLog2(numBits); }
+
+  /// @brief Returns the bits of the record keys, encrypted, least
+  /// significant first.
+  std::vector<CTileTensor> encryptRecordKeys(const std::vector<int>& keys)
+      const
+  {
+    return encryptBits(
+        getRecordShape(static_cast<DimInt>(keys.size())), keys, 0);
+  }
+
+  /// @brief Returns the bits of the query keys, encrypted, least
+  /// significant first.
+  std::vector<CTileTensor> encryptQueryKeys(const std::vector<int>& keys)
+      const
+  {
+    return encryptBits(
+        getQueryShape(static_cast<DimInt>(keys.size())), keys, 1);
+  }
+
+  /// @brief Returns the [records, queries] selection mask: 1 where the
+  /// record key equals the query key and 0 elsewhere. The unused slots are
+  /// unknown.
+  /// @param recordBits The bits of the record keys, from encryptRecordKeys.
+  /// @param queryBits  The bits of the query keys, from encryptQueryKeys.
+  CTileTensor isEqual(const std::vector<CTileTensor>& recordBits,
+                      const std::vector<CTileTensor>& queryBits) const
+  {
+    always_assert((int)recordBits.size() == numBits &&
+                  (int)queryBits.size() == numBits);
+    std::vector<CTileTensor> eq(numBits, CTileTensor(he));
+    parallelFor(0, numBits, [&](int i) {
+      // 1 - (r - q)^2 is 1 where the bits are equal and 0 elsewhere.
+      eq[i] = recordBits[i].getSub(queryBits[i]);
+      eq[i].square();
+      eq[i].negate();
+      eq[i].addScalar(1);
+    });
+    for (int step = 1; step < numBits; step *= 2) {
+      // The pairs (i, i + step), for i a multiple of 2 * step.
+      int numPairs = (numBits + step - 1) / (2 * step);
+      parallelFor(0, numPairs, [&](int p) {
+        int i = 2 * step * p;
+        // With a number of bits that is not a power of 2, the two products
+        // may be of different depths.
+        if (eq[i + step].getChainIndex() > eq[i].getChainIndex())
+          eq[i + step].setChainIndex(eq[i]);
+        eq[i].multiply(eq[i + step]);
+      });
+    }
+    return eq[0];
+  }
+
+  /// @brief Returns, for each query, the value of the record whose key it
+  /// equals, or 0 if there is none, as a [1, queries] tensor.
+  /// @param mask   The selection mask, from isEqual().
+  /// @param values The record values, in the shape of getRecordShape(), with
+  ///               zeros in the unused slots. These clear the unknown unused
+  ///               slots of the mask.
+  CTileTensor lookup(const CTileTensor& mask, const CTileTensor& values)
+      const
+  {
+    return mask.getMultiplyAndSum(values, 0);
+  }
+};
+
+} // namespace helayers
+
+#endif /* TUTORIALS_BATCHED_KEY_LOOKUP_H */
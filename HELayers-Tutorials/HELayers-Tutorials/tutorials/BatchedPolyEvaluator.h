@@ -0,0 +1,196 @@
+//
+//  BatchedPolyEvaluator.h
+//  HELayers-Tutorials
+//
+
+#ifndef TUTORIALS_BATCHED_POLY_EVALUATOR_H
+#define TUTORIALS_BATCHED_POLY_EVALUATOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "helayers/hebase/CTile.h"
+#include "helayers/hebase/Encoder.h"
+#include "helayers/math/CTileTensor.h"
+#include "ParallelFor.h"
+#include "ReductionUtils.h"
+
+namespace helayers {
+
+/// @brief Evaluates one polynomial, in the power basis, on many tiles.
+///
+/// The evaluation schedule is planned once, in the constructor: which powers
+/// of x are needed and how each is computed, x^i = x^(2^t) * x^(i - 2^t) for
+/// the largest 2^t < i, giving each power its minimal depth ceil(log2 i).
+/// The coefficients are encoded once per chain index and shared by all
+/// tiles. The tiles are spread over threads, each running the power ladder
+/// into its own scratch tiles, reused across the tiles it evaluates, and the
+/// terms are accumulated as raw plaintext products, rescaled once. The depth
+/// is ceil(log2 degree) + 1.
+///
+/// Compared to FunctionEvaluator::polyEvalInPlace on each tile, this saves
+/// the per-tile planning, coefficient encoding, and all but one rescale of
+/// the final sum.
+class BatchedPolyEvaluator
+{
+  struct Step
+  {
+    int dst, a, b;
+  };
+
+  const HeContext& he;
+  std::vector<double> coefs;
+  int degree;
+
+  // The powers computed, in order.
+  std::vector<Step> steps;
+
+  // The exponents with nonzero coefficients.
+  std::vector<int> terms;
+
+  // Encoded coefficients of the terms, by the chain index of the input.
+  mutable std::map<int, std::vector<PTile>> encodedCoefs;
+  mutable std::mutex mutex;
+
+  const std::vector<PTile>& getEncodedCoefs(int srcChainIndex) const
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = encodedCoefs.find(srcChainIndex);
+    if (it != encodedCoefs.end())
+      return it->second;
+    Encoder enc(he);
+    int chainIndex = srcChainIndex - ceilLog2(degree);
+    std::vector<PTile> res;
+    for (int i : terms) {
+      res.emplace_back(he);
+      enc.encode(res.back(), coefs[i], chainIndex);
+    }
+    return encodedCoefs[srcChainIndex] = std::move(res);
+  }
+
+  // Evaluates on tile, in place, using the given scratch tiles.
+  void evalTile(CTile& tile,
+                const std::vector<PTile>& pcoefs,
+                std::vector<CTile>& powers,
+                CTile& tmp,
+                CTile& acc) const
+  {
+    powers[1] = tile;
+    for (const Step& s : steps) {
+      powers[s.dst] = powers[s.a];
+      if (s.a == s.b) {
+        powers[s.dst].square();
+      } else if (powers[s.b].getChainIndex() ==
+                 powers[s.dst].getChainIndex()) {
+        powers[s.dst].multiply(powers[s.b]);
+      } else {
+        tmp = powers[s.b];
+        tmp.setChainIndex(powers[s.dst].getChainIndex());
+        powers[s.dst].multiply(tmp);
+      }
+    }
+
+    int chainIndex = tile.getChainIndex() - ceilLog2(degree);
+    for (size_t j = 0; j < terms.size(); ++j) {
+      CTile& term = j == 0 ? acc : tmp;
+      term = powers[terms[j]];
+      if (term.getChainIndex() > chainIndex)
+        term.setChainIndex(chainIndex);
+      term.multiplyPlainRaw(pcoefs[j]);
+      if (j > 0)
+        acc.addRaw(term);
+    }
+    acc.rescale();
+    if (coefs[0] != 0)
+      acc.addScalar(coefs[0]);
+    std::swap(tile, acc);
+  }
+
+public:
+  /// @brief A constructor. Plans the evaluation.
+  /// @param he    The HeContext.
+  /// @param coefs The coefficients of the polynomial. coefs[0] is the free
+  ///              coefficient. At least one other must be nonzero.
+  BatchedPolyEvaluator(const HeContext& he, const std::vector<double>& coefs)
+      : he(he), coefs(coefs), degree(0)
+  {
+    for (int i = 1; i < (int)coefs.size(); ++i)
+      if (coefs[i] != 0) {
+        terms.push_back(i);
+        degree = i;
+      }
+    always_assert(degree > 0);
+
+    std::vector<bool> needed(degree + 1, false);
+    for (int i : terms)
+      needed[i] = true;
+    // Mark the dependencies, from the top down.
+    std::vector<Step> plan(degree + 1);
+    for (int i = degree; i >= 2; --i) {
+      if (!needed[i])
+        continue;
+      int a = 1 << (ceilLog2(i) - 1);
+      plan[i] = Step{i, a, i - a};
+      needed[a] = needed[i - a] = true;
+    }
+    for (int i = 2; i <= degree; ++i)
+      if (needed[i])
+        steps.push_back(plan[i]);
+  }
+
+  /// @brief Returns the multiplication depth of the evaluation.
+  int getMulDepth() const { return ceilLog2(degree) + 1; }
+
+  /// @brief Returns the number of ciphertext-ciphertext multiplications per
+  /// tile.
+  int getNumMultiplications() const { return (int)steps.size(); }
+
+  /// @brief Evaluates the polynomial on each of the given tiles, in place.
+  /// All tiles must be at the same chain index.
+  /// @param tiles      The tiles.
+  /// @param maxThreads The maximal number of threads to use. If not positive,
+  ///                   as many as the hardware runs concurrently.
+  void evalInPlace(std::vector<CTile>& tiles, int maxThreads = 0) const
+  {
+    if (tiles.empty())
+      return;
+    for (const CTile& tile : tiles)
+      always_assert(tile.getChainIndex() == tiles[0].getChainIndex());
+    const std::vector<PTile>& pcoefs =
+        getEncodedCoefs(tiles[0].getChainIndex());
+    int numWorkers = getNumWorkers((int)tiles.size());
+    if (maxThreads > 0)
+      numWorkers = std::min(numWorkers, maxThreads);
+    std::atomic<int> next(0);
+    runWorkers(numWorkers, [&](int) {
+      // Scratch tiles, reused for all the tiles this thread evaluates.
+      std::vector<CTile> powers(degree + 1, CTile(he));
+      CTile tmp(he), acc(he);
+      for (int t = next++; t < (int)tiles.size(); t = next++)
+        evalTile(tiles[t], pcoefs, powers, tmp, acc);
+    });
+  }
+
+  /// @brief Returns the polynomial evaluated on src element-wise. Unused
+  /// slots of the result are marked unknown.
+  /// @param src        The input.
+  /// @param maxThreads As in evalInPlace().
+  CTileTensor eval(const CTileTensor& src, int maxThreads = 0) const
+  {
+    std::vector<CTile> tiles;
+    tiles.reserve(src.getNumUsedTiles());
+    for (int t = 0; t < src.getNumUsedTiles(); ++t)
+      tiles.push_back(src.getTileByFlatIndex(t));
+    evalInPlace(tiles, maxThreads);
+    TTShape shape(src.getShape());
+    shape.setAllUnusedSlotsUnknown();
+    return CTileTensor::createFromCTileVector(he, shape, tiles);
+  }
+};
+
+} // namespace helayers
+
+#endif /* TUTORIALS_BATCHED_POLY_EVALUATOR_H */
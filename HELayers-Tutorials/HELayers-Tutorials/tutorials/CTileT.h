@@ -0,0 +1,127 @@
+//
+//  CTileT.h
+//  HELayers-Tutorials
+//
+
+#ifndef TUTORIALS_CTILE_T_H
+#define TUTORIALS_CTILE_T_H
+
+#include <stdexcept>
+#include <type_traits>
+
+#include "helayers/hebase/CTile.h"
+#include "helayers/hebase/PTile.h"
+
+namespace helayers {
+
+/// @brief A CTile whose backend is known at compile time.
+///
+/// A CTile forwards every operation through a virtual call on its
+/// AbstractCiphertext, after checking whether bootstrapping or chain index
+/// adjustments are needed. CTileT<Backend> checks the backend type once, when
+/// it's constructed, and then calls the backend's methods directly, with no
+/// virtual dispatch and no adjustments. This matters for cheap operations
+/// such as add and negate, done at high rates.
+///
+/// Since nothing is adjusted automatically, operands must already be at the
+/// same chain index and scale, as required by the raw backend operations.
+///
+/// A CTileT holds a regular CTile, so converting to a CTile for generic code
+/// is free (asCTile()), and converting from one costs a single type check.
+template <class Backend>
+class CTileT
+{
+  static_assert(std::is_base_of<AbstractCiphertext, Backend>::value,
+                "Backend must be a ciphertext implementation");
+
+  CTile tile;
+  Backend* backend;
+
+  static Backend* getBackend(CTile& tile)
+  {
+    Backend* res = dynamic_cast<Backend*>(&tile.getImpl());
+    if (res == nullptr)
+      throw std::invalid_argument("CTileT: CTile is of a different backend");
+    return res;
+  }
+
+public:
+  /// @brief Constructs a CTileT holding a copy of the given CTile.
+  /// @throw invalid_argument If the CTile is of a different backend.
+  explicit CTileT(const CTile& src) : tile(src), backend(getBackend(tile)) {}
+
+  /// @brief Constructs a CTileT taking over the given CTile.
+  /// @throw invalid_argument If the CTile is of a different backend.
+  explicit CTileT(CTile&& src)
+      : tile(std::move(src)), backend(getBackend(tile))
+  {}
+
+  // The backend pointer is re-derived from the copy's own ciphertext; its
+  // type is already known, so no check is needed.
+  CTileT(const CTileT& src)
+      : tile(src.tile), backend(static_cast<Backend*>(&tile.getImpl()))
+  {}
+
+  CTileT& operator=(const CTileT& src)
+  {
+    tile = src.tile;
+    backend = static_cast<Backend*>(&tile.getImpl());
+    return *this;
+  }
+
+  /// @brief Returns the held CTile, for use with generic code.
+  const CTile& asCTile() const { return tile; }
+
+  /// @brief Moves the held CTile out. This object must not be used after.
+  CTile release() { return std::move(tile); }
+
+  // Operations, dispatched statically to the backend. See CTile for
+  // documentation.
+  void add(const CTileT& other) { backend->Backend::add(*other.backend); }
+  void addRaw(const CTileT& other)
+  {
+    backend->Backend::addRaw(*other.backend);
+  }
+  void sub(const CTileT& other) { backend->Backend::sub(*other.backend); }
+  void subRaw(const CTileT& other)
+  {
+    backend->Backend::subRaw(*other.backend);
+  }
+  void multiply(const CTileT& other)
+  {
+    backend->Backend::multiply(*other.backend);
+  }
+  void multiplyRaw(const CTileT& other)
+  {
+    backend->Backend::multiplyRaw(*other.backend);
+  }
+  void addPlain(const PTile& p) { backend->Backend::addPlain(p.getImpl()); }
+  void addPlainRaw(const PTile& p)
+  {
+    backend->Backend::addPlainRaw(p.getImpl());
+  }
+  void subPlain(const PTile& p) { backend->Backend::subPlain(p.getImpl()); }
+  void multiplyPlain(const PTile& p)
+  {
+    backend->Backend::multiplyPlain(p.getImpl());
+  }
+  void multiplyPlainRaw(const PTile& p)
+  {
+    backend->Backend::multiplyPlainRaw(p.getImpl());
+  }
+  void multiplyScalar(double val) { backend->Backend::multiplyScalar(val); }
+  void negate() { backend->Backend::negate(); }
+  void square() { backend->Backend::square(); }
+  void squareRaw() { backend->Backend::squareRaw(); }
+  void relinearize() { backend->Backend::relinearize(); }
+  void rescale() { backend->Backend::rescale(); }
+  void rotate(int n) { backend->Backend::rotate(n); }
+
+  int getChainIndex() const { return backend->Backend::getChainIndex(); }
+  double getScale() const { return backend->Backend::getScale(); }
+  int slotCount() const { return backend->Backend::slotCount(); }
+};
+
+} // namespace helayers
+
+#endif /* TUTORIALS_CTILE_T_H */
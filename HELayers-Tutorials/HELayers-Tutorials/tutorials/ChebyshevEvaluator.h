@@ -0,0 +1,336 @@
+//
+//  ChebyshevEvaluator.h
+//  HELayers-Tutorials
+//
+
+#ifndef TUTORIALS_CHEBYSHEV_EVALUATOR_H
+#define TUTORIALS_CHEBYSHEV_EVALUATOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <vector>
+
+#include "helayers/hebase/CTile.h"
+#include "helayers/hebase/Encoder.h"
+#include "helayers/math/CTileTensor.h"
+#include "ParallelFor.h"
+
+namespace helayers {
+
+/// @brief Evaluates polynomials given in the Chebyshev basis on ciphertexts,
+/// with the Paterson-Stockmeyer algorithm.
+///
+/// A polynomial p(x) = sum_i c_i T_i(y), over an interval [a, b], where
+/// y = (2x - a - b) / (b - a) maps [a, b] to [-1, 1] and T_i are the
+/// Chebyshev polynomials. The Chebyshev basis is well conditioned on [-1, 1],
+/// so high degree approximations keep their precision, unlike the power
+/// basis.
+///
+/// The evaluation computes the baby steps T_1..T_k and the giant steps
+/// T_k, T_2k, T_4k, ..., splits p recursively by the giant steps, and
+/// evaluates the leaves as linear combinations of the baby steps. With k
+/// about sqrt(d/2), a degree d polynomial costs about k + d/k + log2(d/k)
+/// ciphertext multiplications, instead of about d: k - 1 for the baby steps,
+/// log2(d/k) - 1 for the giant steps and one per split. The leaves only
+/// multiply by plaintext coefficients, whose products are summed before a
+/// single rescale.
+class ChebyshevEvaluator
+{
+  const HeContext& he;
+  mutable std::atomic<int> numMultiplications{0};
+
+  // A polynomial value: either a ciphertext or a known constant.
+  struct Value
+  {
+    CTile tile;
+    bool isConstant;
+    double constant;
+  };
+
+  // Reduces the chain index of the higher of a and b to that of the other.
+  static void alignChainIndexes(CTile& a, CTile& b)
+  {
+    if (a.getChainIndex() > b.getChainIndex())
+      a.setChainIndex(b.getChainIndex());
+    else if (b.getChainIndex() > a.getChainIndex())
+      b.setChainIndex(a.getChainIndex());
+  }
+
+  // Returns 2 * tm * tn - tdiff, i.e., T_{m+n} given T_m, T_n and T_{|m-n|}.
+  // A null tdiff stands for T_0 = 1.
+  CTile chebyshevProduct(const CTile& tm,
+                         const CTile& tn,
+                         const CTile* tdiff) const
+  {
+    CTile res(tm);
+    CTile other(tn);
+    alignChainIndexes(res, other);
+    res.multiply(other);
+    ++numMultiplications;
+    CTile twice(res);
+    res.add(twice);
+    if (tdiff == nullptr) {
+      res.addScalar(-1.0);
+    } else {
+      CTile d(*tdiff);
+      alignChainIndexes(res, d);
+      res.sub(d);
+    }
+    return res;
+  }
+
+  // Returns sum_i coefs[i] * T_i. coefs[i] must be zero where babies[i] is
+  // missing.
+  Value combineBabySteps(const std::vector<double>& coefs,
+                         const std::vector<CTile>& babies) const
+  {
+    // All products are taken at the lowest chain index of the terms used,
+    // summed raw, and rescaled once.
+    int chainIndex = -1;
+    for (size_t i = 1; i < coefs.size(); ++i)
+      if (coefs[i] != 0 &&
+          (chainIndex < 0 || babies[i].getChainIndex() < chainIndex))
+        chainIndex = babies[i].getChainIndex();
+    if (chainIndex < 0)
+      return Value{CTile(he), true, coefs.empty() ? 0 : coefs[0]};
+
+    Encoder enc(he);
+    CTile res(he);
+    bool started = false;
+    for (size_t i = 1; i < coefs.size(); ++i) {
+      if (coefs[i] == 0)
+        continue;
+      CTile term(babies[i]);
+      term.setChainIndex(chainIndex);
+      PTile c(he);
+      enc.encode(c, coefs[i], chainIndex);
+      term.multiplyPlainRaw(c);
+      if (started) {
+        res.add(term);
+      } else {
+        res = std::move(term);
+        started = true;
+      }
+    }
+    res.rescale();
+    if (coefs[0] != 0)
+      res.addScalar(coefs[0]);
+    return Value{std::move(res), false, 0};
+  }
+
+  // Evaluates sum_i coefs[i] * T_i, where coefs.size() is k * 2^level.
+  Value evalRecursive(const std::vector<double>& coefs,
+                      int level,
+                      const std::vector<CTile>& babies,
+                      const std::vector<CTile>& giants) const
+  {
+    if (level == 0)
+      return combineBabySteps(coefs, babies);
+
+    // Split p = q * T_K + r, with K = coefs.size() / 2, using
+    // T_{K+j} = 2 T_K T_j - T_{K-j}.
+    size_t bigK = coefs.size() / 2;
+    std::vector<double> q(bigK, 0), r(coefs.begin(), coefs.begin() + bigK);
+    q[0] = coefs[bigK];
+    for (size_t j = 1; j < bigK; ++j) {
+      q[j] = 2 * coefs[bigK + j];
+      r[bigK - j] -= coefs[bigK + j];
+    }
+
+    Value qVal = evalRecursive(q, level - 1, babies, giants);
+    Value rVal = evalRecursive(r, level - 1, babies, giants);
+
+    Value res{CTile(giants[level - 1]), false, 0};
+    if (qVal.isConstant) {
+      if (qVal.constant == 0)
+        return rVal;
+      Encoder enc(he);
+      PTile c(he);
+      enc.encode(c, qVal.constant, res.tile.getChainIndex());
+      res.tile.multiplyPlain(c);
+    } else {
+      alignChainIndexes(res.tile, qVal.tile);
+      res.tile.multiply(qVal.tile);
+      ++numMultiplications;
+    }
+    if (rVal.isConstant) {
+      if (rVal.constant != 0)
+        res.tile.addScalar(rVal.constant);
+    } else {
+      alignChainIndexes(res.tile, rVal.tile);
+      res.tile.add(rVal.tile);
+    }
+    return res;
+  }
+
+public:
+  /// @brief A constructor.
+  /// @param he The HeContext.
+  ChebyshevEvaluator(const HeContext& he) : he(he) {}
+
+  /// @brief Returns the Chebyshev coefficients of the polynomial of the given
+  /// degree that interpolates f at the Chebyshev nodes of [a, b]. This is
+  /// close to the best uniform approximation of f on [a, b].
+  static std::vector<double> interpolate(const std::function<double(double)>& f,
+                                         int degree,
+                                         double a = -1,
+                                         double b = 1)
+  {
+    int n = degree + 1;
+    std::vector<double> vals(n);
+    for (int j = 0; j < n; ++j) {
+      double y = std::cos(M_PI * (j + 0.5) / n);
+      vals[j] = f((y * (b - a) + a + b) / 2);
+    }
+    std::vector<double> res(n, 0);
+    for (int i = 0; i < n; ++i) {
+      for (int j = 0; j < n; ++j)
+        res[i] += vals[j] * std::cos(M_PI * i * (j + 0.5) / n);
+      res[i] *= (i == 0 ? 1.0 : 2.0) / n;
+    }
+    return res;
+  }
+
+  /// @brief Evaluates a Chebyshev-basis polynomial on a plain value, with
+  /// Clenshaw's algorithm.
+  static double evalPlain(const std::vector<double>& coefs,
+                          double x,
+                          double a = -1,
+                          double b = 1)
+  {
+    double y = (2 * x - a - b) / (b - a);
+    double b1 = 0, b2 = 0;
+    for (int i = (int)coefs.size() - 1; i >= 1; --i) {
+      double t = 2 * y * b1 - b2 + coefs[i];
+      b2 = b1;
+      b1 = t;
+    }
+    return y * b1 - b2 + (coefs.empty() ? 0 : coefs[0]);
+  }
+
+  /// @brief Returns the number of baby steps used for a polynomial of the
+  /// given degree: a power of 2, about sqrt(degree / 2).
+  static int getNumBabySteps(int degree)
+  {
+    int k = 2;
+    while (2 * k * k < degree + 1)
+      k *= 2;
+    return k;
+  }
+
+  /// @brief Returns the number of giant step levels used for a polynomial of
+  /// the given degree.
+  static int getNumGiantLevels(int degree)
+  {
+    int k = getNumBabySteps(degree);
+    int m = 0;
+    while ((k << m) < degree + 1)
+      ++m;
+    return m;
+  }
+
+  /// @brief Returns the number of ciphertext-ciphertext multiplications
+  /// evaluate() does for a polynomial of the given degree. Splits whose
+  /// quotient turns out constant save one each, so this is exact when no
+  /// quotient is.
+  static int getMaxNumMultiplications(int degree)
+  {
+    int k = getNumBabySteps(degree);
+    int m = getNumGiantLevels(degree);
+    int numBabies = m > 0 ? k : std::min(k - 1, degree);
+    return (numBabies - 1) + std::max(m - 1, 0) + ((1 << m) - 1);
+  }
+
+  /// @brief Returns the multiplicative depth of evaluate() for a polynomial
+  /// of the given degree, not including the interval remapping (one more
+  /// level when [a, b] isn't [-1, 1]).
+  static int getMulDepth(int degree)
+  {
+    int k = getNumBabySteps(degree);
+    int babyDepth = (int)std::ceil(std::log2(std::min(k - 1, degree)));
+    int giantDepth = (int)std::log2(k);
+    // A leaf combination costs one level over the baby steps, and each
+    // split level one over the deeper of its parts and its giant step.
+    int depth = babyDepth + 1;
+    int m = getNumGiantLevels(degree);
+    for (int j = 0; j < m; ++j)
+      depth = std::max(depth, giantDepth + j) + 1;
+    return depth;
+  }
+
+  /// @brief Returns p(src), for p given by its Chebyshev coefficients over
+  /// [a, b]. If p reduces to a constant, it's returned freshly encrypted at
+  /// the chain index of src.
+  CTile evaluate(const CTile& src,
+                 const std::vector<double>& coefs,
+                 double a = -1,
+                 double b = 1) const
+  {
+    always_assert(coefs.size() >= 2);
+    int degree = (int)coefs.size() - 1;
+    CTile y(src);
+    if (a != -1 || b != 1) {
+      y.multiplyScalar(2 / (b - a));
+      y.addScalar(-(a + b) / (b - a));
+    }
+
+    int k = getNumBabySteps(degree);
+    int m = getNumGiantLevels(degree);
+    // The leaves use T_1..T_{k-1}; T_k is only needed as a giant step.
+    int numBabies = m > 0 ? k : std::min(k - 1, degree);
+    std::vector<CTile> babies(numBabies + 1, CTile(he));
+    babies[1] = y;
+    for (int i = 2; i <= numBabies; ++i) {
+      int hi = (i + 1) / 2, lo = i / 2;
+      babies[i] = chebyshevProduct(
+          babies[hi], babies[lo], hi == lo ? nullptr : &babies[hi - lo]);
+    }
+    std::vector<CTile> giants(m, CTile(he));
+    if (m > 0)
+      giants[0] = babies[k];
+    for (int j = 1; j < m; ++j)
+      giants[j] = chebyshevProduct(giants[j - 1], giants[j - 1], nullptr);
+
+    std::vector<double> padded(coefs);
+    padded.resize((size_t)k << m, 0);
+    Value res = evalRecursive(padded, m, babies, giants);
+    if (res.isConstant) {
+      // Multiplying y by 0 would give a transparent ciphertext, which SEAL
+      // rejects, so the constant is encrypted instead.
+      Encoder enc(he);
+      CTile c(he);
+      enc.encodeEncrypt(c,
+                        std::vector<double>(he.slotCount(), res.constant),
+                        src.getChainIndex());
+      return c;
+    }
+    return std::move(res.tile);
+  }
+
+  /// @brief Returns p(src) element-wise, evaluating the tiles in parallel.
+  /// Unused slots of the result are marked unknown, since p(0) may be
+  /// nonzero.
+  CTileTensor evaluate(const CTileTensor& src,
+                       const std::vector<double>& coefs,
+                       double a = -1,
+                       double b = 1) const
+  {
+    std::vector<CTile> tiles(src.getNumUsedTiles(), CTile(he));
+    parallelFor(0, src.getNumUsedTiles(), [&](int t) {
+      tiles[t] = evaluate(src.getTileByFlatIndex(t), coefs, a, b);
+    });
+    TTShape shape(src.getShape());
+    shape.setAllUnusedSlotsUnknown();
+    return CTileTensor::createFromCTileVector(he, shape, tiles);
+  }
+
+  /// @brief Returns the number of ciphertext-ciphertext multiplications done
+  /// so far.
+  int getNumMultiplications() const { return numMultiplications; }
+};
+
+} // namespace helayers
+
+#endif /* TUTORIALS_CHEBYSHEV_EVALUATOR_H */
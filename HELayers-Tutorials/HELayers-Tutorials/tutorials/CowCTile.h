@@ -0,0 +1,190 @@
+//
+//  CowCTile.h
+//  HELayers-Tutorials
+//
+
+#ifndef TUTORIALS_COW_CTILE_H
+#define TUTORIALS_COW_CTILE_H
+
+#include <memory>
+
+#include "helayers/hebase/CTile.h"
+
+namespace helayers {
+
+/// @brief A copy-on-write CTile. Copies of a CowCTile share the same
+/// ciphertext until one of them is modified, at which point the modified copy
+/// gets a ciphertext of its own. Copying a CowCTile is therefore O(1) in time
+/// and memory, while copying a CTile clones the underlying ciphertext.
+///
+/// The reference count is atomic, so different CowCTile objects sharing a
+/// ciphertext may be used from different threads. As with other standard
+/// types, a single CowCTile object must not be modified concurrently with
+/// any other use of that same object.
+///
+/// All of CTile's public mutating methods are forwarded, each detaching
+/// first. Other mutations, e.g., passing the ciphertext to a function taking
+/// a CTile&, must go through getMutable(), never through get().
+class CowCTile
+{
+  std::shared_ptr<CTile> tile;
+
+  /// @brief Gives this object its own ciphertext if it shares it with another
+  /// CowCTile, and returns it.
+  inline CTile& detach()
+  {
+    if (tile.use_count() > 1)
+      tile = std::make_shared<CTile>(*tile);
+    return *tile;
+  }
+
+  /// @brief Gives this object an empty ciphertext of its own, for methods
+  /// that overwrite it entirely, and returns it.
+  inline CTile& reset()
+  {
+    if (tile.use_count() > 1)
+      tile = std::make_shared<CTile>(tile->getImpl().getHeContext());
+    return *tile;
+  }
+
+public:
+  /// @brief Constructs an empty CowCTile.
+  /// @param he The HeContext.
+  explicit CowCTile(const HeContext& he) : tile(std::make_shared<CTile>(he))
+  {}
+
+  /// @brief Constructs a CowCTile holding a copy of the given CTile.
+  explicit CowCTile(const CTile& src) : tile(std::make_shared<CTile>(src)) {}
+
+  /// @brief Constructs a CowCTile taking over the given CTile.
+  explicit CowCTile(CTile&& src)
+      : tile(std::make_shared<CTile>(std::move(src)))
+  {}
+
+  CowCTile(const CowCTile& src) = default;
+  CowCTile(CowCTile&& src) = default;
+  CowCTile& operator=(const CowCTile& src) = default;
+  CowCTile& operator=(CowCTile&& src) = default;
+
+  /// @brief Returns the held ciphertext, for reading.
+  inline const CTile& get() const { return *tile; }
+
+  /// @brief Returns the held ciphertext, for writing. If it's shared with
+  /// another CowCTile it's copied first.
+  inline CTile& getMutable() { return detach(); }
+
+  /// @brief Returns whether the ciphertext is shared with another CowCTile.
+  inline bool isShared() const { return tile.use_count() > 1; }
+
+  // Non-mutating methods. See CTile for documentation.
+  inline int getChainIndex() const { return tile->getChainIndex(); }
+  inline double getScale() const { return tile->getScale(); }
+  inline int slotCount() const { return tile->slotCount(); }
+  inline bool isEmpty() const { return tile->isEmpty(); }
+  inline void debugPrint(const std::string& title = "",
+                         Verbosity verbosity = VERBOSITY_REGULAR,
+                         std::ostream& out = std::cout) const
+  {
+    tile->debugPrint(title, verbosity, out);
+  }
+  inline DeviceType getCurrentDevice() const
+  {
+    return tile->getCurrentDevice();
+  }
+  inline std::streamoff save(std::ostream& stream) const
+  {
+    return tile->save(stream);
+  }
+  inline std::streamoff saveToFile(const std::string& fileName) const
+  {
+    return tile->saveToFile(fileName);
+  }
+
+  // Mutating methods. Each detaches first. See CTile for documentation.
+  inline void conjugate() { detach().conjugate(); }
+  inline void conjugateRaw() { detach().conjugateRaw(); }
+  inline void rotate(int n) { detach().rotate(n); }
+  inline void add(const CTile& other) { detach().add(other); }
+  inline void add(const CowCTile& other) { detach().add(other.get()); }
+  inline void addRaw(const CTile& other) { detach().addRaw(other); }
+  inline void addRaw(const CowCTile& other) { detach().addRaw(other.get()); }
+  inline void sub(const CTile& other) { detach().sub(other); }
+  inline void sub(const CowCTile& other) { detach().sub(other.get()); }
+  inline void subRaw(const CTile& other) { detach().subRaw(other); }
+  inline void subRaw(const CowCTile& other) { detach().subRaw(other.get()); }
+  inline void multiply(const CTile& other) { detach().multiply(other); }
+  inline void multiply(const CowCTile& other)
+  {
+    detach().multiply(other.get());
+  }
+  inline void multiplyRaw(const CTile& other) { detach().multiplyRaw(other); }
+  inline void multiplyRaw(const CowCTile& other)
+  {
+    detach().multiplyRaw(other.get());
+  }
+  inline void addPlain(const PTile& plain) { detach().addPlain(plain); }
+  inline void addPlainRaw(const PTile& plain) { detach().addPlainRaw(plain); }
+  inline void subPlain(const PTile& plain) { detach().subPlain(plain); }
+  inline void subPlainRaw(const PTile& plain) { detach().subPlainRaw(plain); }
+  inline void multiplyPlain(const PTile& plain)
+  {
+    detach().multiplyPlain(plain);
+  }
+  inline void multiplyPlainRaw(const PTile& plain)
+  {
+    detach().multiplyPlainRaw(plain);
+  }
+  inline void square() { detach().square(); }
+  inline void squareRaw() { detach().squareRaw(); }
+  inline void multiplyByChangingScale(double factor)
+  {
+    detach().multiplyByChangingScale(factor);
+  }
+  inline void addScalar(int scalar) { detach().addScalar(scalar); }
+  inline void addScalar(double scalar) { detach().addScalar(scalar); }
+  inline void multiplyScalar(int scalar) { detach().multiplyScalar(scalar); }
+  inline void multiplyScalar(double scalar)
+  {
+    detach().multiplyScalar(scalar);
+  }
+  inline void relinearize() { detach().relinearize(); }
+  inline void rescale() { detach().rescale(); }
+  inline void rescaleRaw() { detach().rescaleRaw(); }
+  inline void negate() { detach().negate(); }
+  inline void setScale(double scale) { detach().setScale(scale); }
+  inline void reduceChainIndex() { detach().reduceChainIndex(); }
+  inline void setChainIndex(int chainIndex)
+  {
+    // Avoid detaching when nothing changes
+    if (tile->getChainIndex() != chainIndex)
+      detach().setChainIndex(chainIndex);
+  }
+  inline void innerSum(int rot1, int rot2, bool reverse = false)
+  {
+    detach().innerSum(rot1, rot2, reverse);
+  }
+  inline void sumExpBySquaringLeftToRight(int n)
+  {
+    detach().sumExpBySquaringLeftToRight(n);
+  }
+  inline void sumExpBySquaringRightToLeft(int n)
+  {
+    detach().sumExpBySquaringRightToLeft(n);
+  }
+  inline void bootstrap() { detach().bootstrap(); }
+  inline void toDevice(DeviceType device) { detach().toDevice(device); }
+
+  // Loading overwrites the ciphertext, so a shared one is not copied first.
+  inline std::streamoff load(std::istream& stream)
+  {
+    return reset().load(stream);
+  }
+  inline std::streamoff loadFromFile(const std::string& fileName)
+  {
+    return reset().loadFromFile(fileName);
+  }
+};
+
+} // namespace helayers
+
+#endif /* TUTORIALS_COW_CTILE_H */
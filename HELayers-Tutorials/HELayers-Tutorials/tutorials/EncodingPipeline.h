@@ -0,0 +1,153 @@
+//
+//  EncodingPipeline.h
+//  HELayers-Tutorials
+//
+
+#ifndef TUTORIALS_ENCODING_PIPELINE_H
+#define TUTORIALS_ENCODING_PIPELINE_H
+
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "helayers/math/PTileTensor.h"
+
+namespace helayers {
+
+/// @brief Encodes lazily encoded plaintexts in the background, ahead of
+/// their use.
+///
+/// A PTileTensor created by a TTEncoder in LAZY_ENCODING mode holds only its
+/// raw values while asleep, and wakeup() encodes it, on the caller's thread.
+/// An EncodingPipeline is given a sequence of such tensors, e.g., the
+/// weights of a model's layers in order, each with the chain index it will be
+/// used at. When stage i is acquired, the following stages are woken up on
+/// background threads, so their encoding overlaps the computation of stage
+/// i. At most maxAwake stages are awake at once, except as noted in
+/// acquire(); released stages are put back to sleep.
+///
+/// Each stage must be acquired and released in order, from a single thread.
+class EncodingPipeline
+{
+  struct Stage
+  {
+    PTileTensor* tensor;
+    int chainIndex;
+    std::future<void> pending;
+    bool awake = false;
+
+    Stage(PTileTensor* tensor, int chainIndex)
+        : tensor(tensor), chainIndex(chainIndex)
+    {}
+  };
+
+  std::vector<Stage> stages;
+  int maxAwake;
+  int numAwake = 0;
+
+  // Index of the next stage to start waking up.
+  int nextToWake = 0;
+
+  void startWakeup(int i)
+  {
+    Stage& s = stages[i];
+    PTileTensor* tensor = s.tensor;
+    int chainIndex = s.chainIndex;
+    s.pending = std::async(std::launch::async, [tensor, chainIndex]() {
+      tensor->setLazyChainIndex(chainIndex);
+      tensor->wakeup();
+    });
+    s.awake = true;
+    ++numAwake;
+  }
+
+  void putToSleep(int i)
+  {
+    Stage& s = stages[i];
+    if (s.pending.valid())
+      s.pending.get();
+    s.tensor->sleep();
+    s.awake = false;
+    --numAwake;
+  }
+
+  void fillAhead()
+  {
+    for (; nextToWake < (int)stages.size() && numAwake < maxAwake;
+         ++nextToWake)
+      if (!stages[nextToWake].awake)
+        startWakeup(nextToWake);
+  }
+
+public:
+  /// @brief A constructor.
+  /// @param maxAwake The maximal number of stages awake at once, including
+  ///                 the one in use. Must be at least 1.
+  explicit EncodingPipeline(int maxAwake = 2) : maxAwake(maxAwake)
+  {
+    always_assert(maxAwake >= 1);
+  }
+
+  ~EncodingPipeline()
+  {
+    for (Stage& s : stages)
+      if (s.pending.valid())
+        s.pending.wait();
+  }
+
+  /// @brief Adds a stage. The tensor must be lazily encoded and asleep, and
+  /// must outlive the pipeline.
+  /// @param tensor     The tensor.
+  /// @param chainIndex The chain index it will be used at.
+  void addStage(PTileTensor& tensor, int chainIndex)
+  {
+    always_assert(tensor.isSleeping());
+    stages.emplace_back(&tensor, chainIndex);
+  }
+
+  /// @brief Starts encoding the first stages in the background.
+  void start() { fillAhead(); }
+
+  /// @brief Returns the tensor of stage i, encoded, waiting for its encoding
+  /// to complete if needed. If stage i isn't awake, e.g., because it was
+  /// released before, and maxAwake stages are, the furthest stage woken ahead
+  /// of i is put back to sleep to make room. If all the awake stages come
+  /// before i, i.e., are still in use, stage i is woken anyway, exceeding
+  /// maxAwake until one of them is released.
+  const PTileTensor& acquire(int i)
+  {
+    Stage& s = stages.at(i);
+    if (!s.awake) {
+      if (numAwake >= maxAwake) {
+        for (int j = (int)stages.size() - 1; j > i; --j)
+          if (stages[j].awake) {
+            putToSleep(j);
+            nextToWake = std::min(nextToWake, j);
+            break;
+          }
+      }
+      startWakeup(i);
+      if (nextToWake <= i)
+        nextToWake = i + 1;
+    }
+    if (s.pending.valid())
+      s.pending.get();
+    fillAhead();
+    return *s.tensor;
+  }
+
+  /// @brief Puts stage i back to sleep, freeing its encoded tiles, and starts
+  /// encoding the next stage in line.
+  void release(int i)
+  {
+    if (!stages.at(i).awake)
+      return;
+    putToSleep(i);
+    fillAhead();
+  }
+};
+
+} // namespace helayers
+
+#endif /* TUTORIALS_ENCODING_PIPELINE_H */
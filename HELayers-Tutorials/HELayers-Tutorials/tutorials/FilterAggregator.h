@@ -0,0 +1,301 @@
+//
+//  FilterAggregator.h
+//  HELayers-Tutorials
+//
+
+#ifndef TUTORIALS_FILTER_AGGREGATOR_H
+#define TUTORIALS_FILTER_AGGREGATOR_H
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "helayers/hebase/Encoder.h"
+#include "helayers/math/CTileTensor.h"
+#include "helayers/math/TTEncoder.h"
+#include "ParallelFor.h"
+#include "ReductionUtils.h"
+
+namespace helayers {
+
+/// @brief Computes SUM and COUNT over the rows whose encrypted key equals
+/// plaintext keys, as in SELECT SUM(v), COUNT(*) ... WHERE k = key, or
+/// GROUP BY k over a small domain of keys.
+///
+/// The keys are bit-decomposed, each bit a column of rows. Against a
+/// plaintext key, the equality of a bit is the bit or its complement, with
+/// no multiplication, and the equality of the key is the product of those
+/// of its bits, taken by splitting the bits in halves. The products of each
+/// half are computed once and shared by all the keys that agree on it, so a
+/// group by over many keys costs little more than one comparison. A key of
+/// b bits takes ceil(log2 b) levels.
+///
+/// Each tile of rows is filtered and aggregated on its own, the tiles spread
+/// over threads with an accumulator each: its masks are multiplied into the
+/// values, at the chain index of the masks, and added up unrelinearized and
+/// unrescaled, so no mask tensor over all the rows is kept. The masks
+/// themselves are the counts, except in the last tile, when partly used,
+/// where they're multiplied by the used rows. The sums are relinearized and
+/// rescaled once per key, and all totals are summed over the slots. Sums
+/// take one level more than the masks, and counts at most one.
+class FilterAggregator
+{
+  const HeContext& he;
+  int numBits;
+
+  using Masks = std::map<int, CTile>;
+
+  // Returns the equality masks of bits [lo, hi) of the keys in bits with
+  // each of the given values of these bits.
+  static Masks getMasks(const std::vector<CTile>& bits,
+                        int lo,
+                        int hi,
+                        const std::set<int>& subKeys)
+  {
+    Masks res;
+    if (hi - lo == 1) {
+      for (int b : subKeys) {
+        CTile lit(bits[lo]);
+        if (b == 0) {
+          lit.negate();
+          lit.addScalar(1);
+        }
+        res.emplace(b, std::move(lit));
+      }
+      return res;
+    }
+    int mid = (lo + hi) / 2;
+    int lowBits = (1 << (mid - lo)) - 1;
+    std::set<int> lows, highs;
+    for (int k : subKeys) {
+      lows.insert(k & lowBits);
+      highs.insert(k >> (mid - lo));
+    }
+    Masks lowMasks = getMasks(bits, lo, mid, lows);
+    Masks highMasks = getMasks(bits, mid, hi, highs);
+    for (int k : subKeys) {
+      CTile mask(lowMasks.at(k & lowBits));
+      CTile high(highMasks.at(k >> (mid - lo)));
+      // The halves differ in depth when their numbers of bits do.
+      if (high.getChainIndex() > mask.getChainIndex())
+        high.setChainIndex(mask.getChainIndex());
+      else
+        mask.setChainIndex(high.getChainIndex());
+      mask.multiply(high);
+      res.emplace(k, std::move(mask));
+    }
+    return res;
+  }
+
+  static void accumulate(Masks& acc, int key, CTile& term)
+  {
+    auto it = acc.find(key);
+    if (it == acc.end())
+      acc.emplace(key, std::move(term));
+    else
+      it->second.addRaw(term);
+  }
+
+  // Computes the sums of values, if given, and the counts, if given, of the
+  // rows whose key is each of keys.
+  void aggregate(const std::vector<CTileTensor>& keyBits,
+                 const CTileTensor* values,
+                 const std::vector<int>& keys,
+                 std::vector<CTile>* sums,
+                 std::vector<CTile>* counts) const
+  {
+    always_assert((int)keyBits.size() == numBits);
+    std::set<int> keySet;
+    for (int k : keys) {
+      always_assert(k >= 0 && k < (1 << numBits));
+      keySet.insert(k);
+    }
+    int numTiles = keyBits[0].getNumUsedTiles();
+    int numRows = keyBits[0].getShape().getDim(0).getOriginalSize();
+    int chainIndex =
+        keyBits[0].getTileByFlatIndex(0).getChainIndex() - getMaskDepth();
+
+    // Only the last tile may be partly used. Its unused slots hold key 0,
+    // so for counting, its masks are multiplied by the used rows.
+    int numLastRows = numRows - (numTiles - 1) * he.slotCount();
+    bool isLastPartial = numLastRows < he.slotCount();
+    Encoder enc(he);
+    PTile used(he);
+    if (counts != nullptr && isLastPartial) {
+      std::vector<double> vals(he.slotCount(), 0);
+      std::fill(vals.begin(), vals.begin() + numLastRows, 1);
+      enc.encode(used, vals, chainIndex);
+    }
+
+    // Each worker aggregates the tiles w, w + numWorkers, ... into its own
+    // accumulators. The masked counts of the last tile are a level lower, so
+    // they're kept apart.
+    struct Accumulators
+    {
+      Masks sums, counts, lastCounts;
+    };
+    int numWorkers = getNumWorkers(numTiles);
+    std::vector<Accumulators> accs(numWorkers);
+    runWorkers(numWorkers, [&](int w) {
+      for (int t = w; t < numTiles; t += numWorkers) {
+        std::vector<CTile> bits;
+        for (int i = 0; i < numBits; ++i)
+          bits.push_back(keyBits[i].getTileByFlatIndex(t));
+        Masks masks = getMasks(bits, 0, numBits, keySet);
+        CTile value(he);
+        if (sums != nullptr) {
+          value = values->getTileByFlatIndex(t);
+          value.setChainIndex(chainIndex);
+        }
+        for (auto& m : masks) {
+          always_assert(m.second.getChainIndex() == chainIndex);
+          if (sums != nullptr) {
+            CTile term(m.second);
+            term.multiplyRaw(value);
+            accumulate(accs[w].sums, m.first, term);
+          }
+          if (counts == nullptr)
+            continue;
+          if (t == numTiles - 1 && isLastPartial) {
+            m.second.multiplyPlain(used);
+            accs[w].lastCounts.emplace(m.first, std::move(m.second));
+          } else {
+            accumulate(accs[w].counts, m.first, m.second);
+          }
+        }
+      }
+    });
+
+    Masks sumAcc, countAcc;
+    for (Accumulators& acc : accs) {
+      for (auto& s : acc.sums)
+        accumulate(sumAcc, s.first, s.second);
+      for (auto& c : acc.counts)
+        accumulate(countAcc, c.first, c.second);
+    }
+    for (Accumulators& acc : accs) {
+      for (auto& c : acc.lastCounts) {
+        auto it = countAcc.find(c.first);
+        if (it == countAcc.end()) {
+          countAcc.emplace(c.first, std::move(c.second));
+          continue;
+        }
+        it->second.setChainIndex(c.second.getChainIndex());
+        it->second.add(c.second);
+      }
+    }
+
+    // The sums are products of ciphertexts, so they're relinearized and
+    // rescaled before they're rotated. The counts already are.
+    std::vector<std::pair<CTile*, bool>> totals;
+    for (auto& s : sumAcc)
+      totals.emplace_back(&s.second, true);
+    for (auto& c : countAcc)
+      totals.emplace_back(&c.second, false);
+    parallelFor(0, (int)totals.size(), [&](int i) {
+      CTile& total = *totals[i].first;
+      if (totals[i].second) {
+        total.relinearize();
+        total.rescale();
+      }
+      total.innerSum(1, he.slotCount());
+    });
+    for (int k : keys) {
+      if (sums != nullptr)
+        sums->push_back(sumAcc.at(k));
+      if (counts != nullptr)
+        counts->push_back(countAcc.at(k));
+    }
+  }
+
+public:
+  /// @brief A constructor.
+  /// @param he      The HeContext.
+  /// @param numBits The number of bits of a key.
+  FilterAggregator(const HeContext& he, int numBits)
+      : he(he), numBits(numBits)
+  {}
+
+  /// @brief Returns the shape of a column of numRows rows.
+  TTShape getShape(DimInt numRows) const
+  {
+    TTShape res({static_cast<DimInt>(he.slotCount())});
+    res.setOriginalSizes({numRows});
+    return res;
+  }
+
+  /// @brief Returns the bits of the given keys, encrypted, least significant
+  /// first, each a column in the shape of getShape().
+  std::vector<CTileTensor> encryptKeys(const std::vector<int>& keys) const
+  {
+    TTEncoder enc(he);
+    DimInt numRows = static_cast<DimInt>(keys.size());
+    std::vector<CTileTensor> res(numBits, CTileTensor(he));
+    for (int i = 0; i < numBits; ++i) {
+      DoubleTensor bits({numRows});
+      for (DimInt r = 0; r < numRows; ++r)
+        bits.at(r) = (keys[r] >> i) & 1;
+      enc.encodeEncrypt(res[i], getShape(numRows), bits);
+    }
+    return res;
+  }
+
+  /// @brief Returns the multiplication depth of the equality masks.
+  int getMaskDepth() const { return ceilLog2(numBits); }
+
+  /// @brief Returns the multiplication depth of the sums and counts. Counts
+  /// over fully used tiles take one level less.
+  int getDepth() const { return getMaskDepth() + 1; }
+
+  /// @brief Returns the sum of values over the rows whose key is key, in all
+  /// slots.
+  /// @param keyBits The bits of the row keys, from encryptKeys().
+  /// @param values  The row values, in the shape of getShape(), with zeros in
+  ///                the unused slots.
+  /// @param key     The key to filter by.
+  CTile sumWhereEqual(const std::vector<CTileTensor>& keyBits,
+                      const CTileTensor& values,
+                      int key) const
+  {
+    std::vector<CTile> sums;
+    aggregate(keyBits, &values, {key}, &sums, nullptr);
+    return sums[0];
+  }
+
+  /// @brief Returns the number of rows whose key is key, in all slots.
+  CTile countWhereEqual(const std::vector<CTileTensor>& keyBits, int key) const
+  {
+    std::vector<CTile> counts;
+    aggregate(keyBits, nullptr, {key}, nullptr, &counts);
+    return counts[0];
+  }
+
+  /// @brief Returns the sum of values over the rows of each of keys, in all
+  /// slots, in the order of keys.
+  std::vector<CTile> groupBySum(const std::vector<CTileTensor>& keyBits,
+                                const CTileTensor& values,
+                                const std::vector<int>& keys) const
+  {
+    std::vector<CTile> sums;
+    aggregate(keyBits, &values, keys, &sums, nullptr);
+    return sums;
+  }
+
+  /// @brief Computes both the sums of values and the counts of the rows of
+  /// each of keys, in the order of keys, sharing the masks.
+  void groupBy(const std::vector<CTileTensor>& keyBits,
+               const CTileTensor& values,
+               const std::vector<int>& keys,
+               std::vector<CTile>& sums,
+               std::vector<CTile>& counts) const
+  {
+    sums.clear();
+    counts.clear();
+    aggregate(keyBits, &values, keys, &sums, &counts);
+  }
+};
+
+} // namespace helayers
+
+#endif /* TUTORIALS_FILTER_AGGREGATOR_H */
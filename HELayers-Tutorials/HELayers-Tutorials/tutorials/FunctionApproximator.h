@@ -0,0 +1,545 @@
+//
+//  FunctionApproximator.h
+//  HELayers-Tutorials
+//
+
+#ifndef TUTORIALS_FUNCTION_APPROXIMATOR_H
+#define TUTORIALS_FUNCTION_APPROXIMATOR_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "helayers/hebase/FileUtils.h"
+#include "helayers/hebase/utils/BinIoUtils.h"
+#include "helayers/math/FunctionEvaluator.h"
+#include "ChebyshevEvaluator.h"
+#include "ParallelFor.h"
+
+namespace helayers {
+
+/// @brief The algorithm an ApproximationPlan is evaluated with.
+enum ApproximationMethod
+{
+  /// Chebyshev basis, Paterson-Stockmeyer (ChebyshevEvaluator)
+  CHEBYSHEV_PS,
+
+  /// Power basis, FunctionEvaluator::polyEval with PATERSONSTOCKMAYER
+  POWER_PS,
+
+  /// Power basis, FunctionEvaluator::efficientPowersPolyEvalInPlace
+  POWER_EFFICIENT_POWERS,
+
+  /// Power basis, FunctionEvaluator::minDepthPolyEvalInPlace
+  POWER_MIN_DEPTH
+};
+
+/// @brief A polynomial approximation of a function over an interval,
+/// together with the algorithm chosen to evaluate it.
+struct ApproximationPlan
+{
+  /// The approximated interval.
+  double a = -1, b = 1;
+
+  /// The degree of the polynomial.
+  int degree = 0;
+
+  /// The maximal approximation error over [a, b], measured on a dense grid.
+  double maxError = 0;
+
+  /// The chosen evaluation method.
+  ApproximationMethod method = CHEBYSHEV_PS;
+
+  /// The multiplication depth of the evaluation.
+  int depth = 0;
+
+  /// The estimated number of ciphertext-ciphertext multiplications.
+  int estimatedMultiplications = 0;
+
+  /// The Chebyshev coefficients, over [a, b].
+  std::vector<double> chebyshevCoefs;
+
+  /// The power basis coefficients, in x. Empty unless a power basis method
+  /// was chosen.
+  std::vector<double> powerCoefs;
+
+  void save(std::ostream& out) const
+  {
+    BinIoUtils::writeDouble(out, a);
+    BinIoUtils::writeDouble(out, b);
+    BinIoUtils::writeInt(out, degree);
+    BinIoUtils::writeDouble(out, maxError);
+    BinIoUtils::writeEnum(out, method);
+    BinIoUtils::writeInt(out, depth);
+    BinIoUtils::writeInt(out, estimatedMultiplications);
+    BinIoUtils::writeDoubleVector(out, chebyshevCoefs);
+    BinIoUtils::writeDoubleVector(out, powerCoefs);
+  }
+
+  void load(std::istream& in)
+  {
+    a = BinIoUtils::readDouble(in);
+    b = BinIoUtils::readDouble(in);
+    degree = BinIoUtils::readInt(in);
+    maxError = BinIoUtils::readDouble(in);
+    method = BinIoUtils::readEnum<ApproximationMethod>(in);
+    depth = BinIoUtils::readInt(in);
+    estimatedMultiplications = BinIoUtils::readInt(in);
+    chebyshevCoefs = BinIoUtils::readDoubleVector(in);
+    powerCoefs = BinIoUtils::readDoubleVector(in);
+  }
+
+  void debugPrint(const std::string& title = "",
+                  std::ostream& out = std::cout) const
+  {
+    static const char* names[] = {"Chebyshev PS",
+                                  "power PS",
+                                  "power efficient powers",
+                                  "power min depth"};
+    out << title << ": degree " << degree << " on [" << a << ", " << b
+        << "], max error " << maxError << ", " << names[method] << ", depth "
+        << depth << ", ~" << estimatedMultiplications << " multiplications"
+        << std::endl;
+  }
+};
+
+/// @brief Compiles scalar functions into polynomial approximations for
+/// ciphertexts.
+///
+/// Given f, an interval [a, b], an error bound and the available depth,
+/// compile() finds the lowest degree minimax polynomial (fitted with the
+/// Remez algorithm in the Chebyshev basis) whose error is within the bound,
+/// and chooses, among the evaluation methods that fit in the depth, the one
+/// with the fewest estimated ciphertext multiplications. Power basis methods
+/// are only considered when the conversion to the power basis doesn't lose
+/// more precision than the error bound allows, which usually rules them out
+/// for high degrees.
+///
+/// Compiled plans are cached in memory and, if a cache directory is given,
+/// on disk, by function name and compilation parameters. Since a
+/// std::function can't be hashed, the name must identify the function.
+class FunctionApproximator
+{
+  const HeContext& he;
+  std::string cacheDir;
+  std::map<std::string, ApproximationPlan> plans;
+  std::mutex mutex;
+
+  // Solves A x = rhs in place with Gaussian elimination with partial
+  // pivoting. Returns false if A is singular.
+  static bool solve(std::vector<std::vector<double>>& A,
+                    std::vector<double>& rhs)
+  {
+    int n = (int)rhs.size();
+    for (int col = 0; col < n; ++col) {
+      int pivot = col;
+      for (int r = col + 1; r < n; ++r)
+        if (std::fabs(A[r][col]) > std::fabs(A[pivot][col]))
+          pivot = r;
+      if (A[pivot][col] == 0)
+        return false;
+      std::swap(A[col], A[pivot]);
+      std::swap(rhs[col], rhs[pivot]);
+      for (int r = col + 1; r < n; ++r) {
+        double factor = A[r][col] / A[col][col];
+        for (int c = col; c < n; ++c)
+          A[r][c] -= factor * A[col][c];
+        rhs[r] -= factor * rhs[col];
+      }
+    }
+    for (int r = n - 1; r >= 0; --r) {
+      for (int c = r + 1; c < n; ++c)
+        rhs[r] -= A[r][c] * rhs[c];
+      rhs[r] /= A[r][r];
+    }
+    return true;
+  }
+
+  static double getMaxError(const std::function<double(double)>& f,
+                            const std::vector<double>& coefs,
+                            double a,
+                            double b)
+  {
+    const int numPoints = 4000;
+    double res = 0;
+    for (int i = 0; i < numPoints; ++i) {
+      double x = a + (b - a) * i / (numPoints - 1);
+      res = std::max(
+          res, std::fabs(f(x) - ChebyshevEvaluator::evalPlain(coefs, x, a, b)));
+    }
+    return res;
+  }
+
+  // Returns the coefficients of p(x) = sum_i coefs[i] T_i(y), y = alpha x +
+  // beta, in the power basis.
+  static std::vector<double> toPowerBasis(const std::vector<double>& coefs,
+                                          double a,
+                                          double b)
+  {
+    int n = (int)coefs.size();
+    double alpha = 2 / (b - a), beta = -(a + b) / (b - a);
+    // y as a polynomial in x, and T_{i-1}, T_i as polynomials in x.
+    std::vector<double> prev(n, 0), cur(n, 0), res(n, 0);
+    prev[0] = 1;
+    cur[0] = beta;
+    if (n > 1)
+      cur[1] = alpha;
+    res[0] = coefs[0];
+    for (int i = 1; i < n; ++i) {
+      for (int j = 0; j < n; ++j)
+        res[j] += coefs[i] * cur[j];
+      // T_{i+1} = 2 y T_i - T_{i-1}
+      std::vector<double> next(n, 0);
+      for (int j = 0; j < n; ++j) {
+        if (cur[j] == 0)
+          continue;
+        next[j] += 2 * beta * cur[j];
+        if (j + 1 < n)
+          next[j + 1] += 2 * alpha * cur[j];
+      }
+      for (int j = 0; j < n; ++j)
+        next[j] -= prev[j];
+      prev = std::move(cur);
+      cur = std::move(next);
+    }
+    return res;
+  }
+
+  static std::string getKey(const std::string& name,
+                            double a,
+                            double b,
+                            double maxError,
+                            int maxDepth,
+                            int maxDegree,
+                            double scale)
+  {
+    std::ostringstream key;
+    key.precision(17);
+    key << name << "|" << a << "|" << b << "|" << maxError << "|" << maxDepth
+        << "|" << maxDegree << "|" << scale;
+    return key.str();
+  }
+
+  // The 64-bit FNV-1a hash. Unlike std::hash, it's the same across runs,
+  // platforms and standard libraries, so file names stay valid.
+  static uint64_t getFnv1aHash(const std::string& str)
+  {
+    uint64_t res = 14695981039346656037ULL;
+    for (unsigned char c : str) {
+      res ^= c;
+      res *= 1099511628211ULL;
+    }
+    return res;
+  }
+
+  std::string getCachePath(const std::string& key) const
+  {
+    std::ostringstream name;
+    name << std::hex << getFnv1aHash(key);
+    return cacheDir + "/" + name.str() + ".plan";
+  }
+
+  bool loadFromDisk(const std::string& key, ApproximationPlan& plan) const
+  {
+    if (cacheDir.empty())
+      return false;
+    std::string path = getCachePath(key);
+    if (!FileUtils::fileExists(path))
+      return false;
+    try {
+      std::ifstream in = FileUtils::openIfstream(path);
+      // Hash collisions are detected by the stored key.
+      if (BinIoUtils::readString(in) != key)
+        return false;
+      plan.load(in);
+      return true;
+    } catch (const std::exception&) {
+      return false;
+    }
+  }
+
+  void saveToDisk(const std::string& key, const ApproximationPlan& plan) const
+  {
+    if (cacheDir.empty())
+      return;
+    std::ofstream out = FileUtils::openOfstream(getCachePath(key));
+    BinIoUtils::writeString(out, key);
+    plan.save(out);
+  }
+
+  ApproximationPlan choosePlan(const std::vector<double>& coefs,
+                               double a,
+                               double b,
+                               double maxError,
+                               int maxDepth) const
+  {
+    int degree = (int)coefs.size() - 1;
+    std::vector<ApproximationPlan> candidates;
+
+    ApproximationPlan cheb;
+    cheb.method = CHEBYSHEV_PS;
+    cheb.depth = ChebyshevEvaluator::getMulDepth(degree) +
+                 (a != -1 || b != 1 ? 1 : 0);
+    cheb.estimatedMultiplications =
+        ChebyshevEvaluator::getMaxNumMultiplications(degree);
+    candidates.push_back(cheb);
+
+    // In the Chebyshev basis all intermediate values are in [-1, 1]. In the
+    // power basis, the powers of x grow up to r^degree, and the terms are
+    // summed at magnitude up to sum_i |p_i| r^i while each is only precise
+    // to about 1/scale. Use it only if that doesn't overflow and the
+    // precision loss is well within the error bound.
+    std::vector<double> power = toPowerBasis(coefs, a, b);
+    double r = std::max(std::fabs(a), std::fabs(b));
+    double magnitude = 0;
+    for (int i = 0; i <= degree; ++i)
+      magnitude += std::fabs(power[i]) * std::pow(r, i);
+    double maxAllowed =
+        he.getMaxAllowedValueByRange(he.getTopChainIndex(), 0);
+    if (std::max(magnitude, std::pow(r, degree)) < maxAllowed &&
+        magnitude / he.getDefaultScale() * (degree + 1) < maxError / 10) {
+      int log2Degree = (int)std::ceil(std::log2(degree + 1));
+      ApproximationPlan p;
+      p.powerCoefs = power;
+      p.method = POWER_PS;
+      p.depth =
+          FunctionEvaluator::getPolyEvalMulDepth(power, PATERSONSTOCKMAYER);
+      p.estimatedMultiplications =
+          2 * (int)std::ceil(std::sqrt(degree)) + log2Degree;
+      candidates.push_back(p);
+      p.method = POWER_EFFICIENT_POWERS;
+      p.depth = FunctionEvaluator::getPolyEvalMulDepth(power, EFFICIENT_POWERS);
+      p.estimatedMultiplications = degree - 1;
+      candidates.push_back(p);
+      p.method = POWER_MIN_DEPTH;
+      p.depth = FunctionEvaluator::getPolyEvalMulDepth(power, MIN_DEPTH);
+      p.estimatedMultiplications = degree - 1 + log2Degree;
+      candidates.push_back(p);
+    }
+
+    const ApproximationPlan* best = nullptr;
+    for (const ApproximationPlan& c : candidates) {
+      if (c.depth > maxDepth)
+        continue;
+      if (best == nullptr ||
+          c.estimatedMultiplications < best->estimatedMultiplications ||
+          (c.estimatedMultiplications == best->estimatedMultiplications &&
+           c.depth < best->depth))
+        best = &c;
+    }
+    ApproximationPlan res;
+    if (best == nullptr) {
+      res.depth = -1;
+      return res;
+    }
+    res = *best;
+    res.a = a;
+    res.b = b;
+    res.degree = degree;
+    res.chebyshevCoefs = coefs;
+    return res;
+  }
+
+public:
+  /// @brief A constructor.
+  /// @param he       The HeContext.
+  /// @param cacheDir A writable directory to cache compiled plans in, such
+  ///                 as the app's caches directory. It's created, with its
+  ///                 parents, if missing. If empty, plans are cached in
+  ///                 memory only.
+  FunctionApproximator(const HeContext& he, const std::string& cacheDir = "")
+      : he(he), cacheDir(cacheDir)
+  {
+    if (!cacheDir.empty())
+      std::filesystem::create_directories(cacheDir);
+  }
+
+  /// @brief Returns the Chebyshev coefficients, over [a, b], of the minimax
+  /// polynomial of the given degree for f, fitted with the Remez algorithm.
+  /// @param f        The function.
+  /// @param degree   The degree.
+  /// @param a, b     The interval.
+  /// @param maxError If not null, receives the maximal error on [a, b].
+  static std::vector<double> remez(const std::function<double(double)>& f,
+                                   int degree,
+                                   double a,
+                                   double b,
+                                   double* maxError = nullptr)
+  {
+    // Start from Chebyshev interpolation, which is near optimal.
+    std::vector<double> best = ChebyshevEvaluator::interpolate(f, degree, a, b);
+    double bestError = getMaxError(f, best, a, b);
+
+    auto toX = [a, b](double y) { return (y * (b - a) + a + b) / 2; };
+    int numNodes = degree + 2;
+    std::vector<double> nodes(numNodes);
+    for (int j = 0; j < numNodes; ++j)
+      nodes[j] = -std::cos(M_PI * j / (numNodes - 1));
+    const int numGrid = std::max(2000, 50 * numNodes);
+    std::vector<double> grid(numGrid), err(numGrid);
+    for (int i = 0; i < numGrid; ++i)
+      grid[i] = -std::cos(M_PI * i / (numGrid - 1));
+
+    for (int iter = 0; iter < 30; ++iter) {
+      // Solve sum_i c_i T_i(y_j) + (-1)^j E = f(y_j) for the nodes.
+      std::vector<std::vector<double>> A(numNodes,
+                                         std::vector<double>(numNodes));
+      std::vector<double> rhs(numNodes);
+      for (int j = 0; j < numNodes; ++j) {
+        double y = nodes[j], t0 = 1, t1 = y;
+        for (int i = 0; i <= degree; ++i) {
+          A[j][i] = t0;
+          double t2 = 2 * y * t1 - t0;
+          t0 = t1;
+          t1 = t2;
+        }
+        A[j][degree + 1] = j % 2 == 0 ? 1 : -1;
+        rhs[j] = f(toX(y));
+      }
+      if (!solve(A, rhs))
+        break;
+      std::vector<double> coefs(rhs.begin(), rhs.begin() + degree + 1);
+
+      // Find the alternating extrema of the error.
+      double iterError = 0;
+      for (int i = 0; i < numGrid; ++i) {
+        err[i] = f(toX(grid[i])) -
+                 ChebyshevEvaluator::evalPlain(coefs, grid[i]);
+        iterError = std::max(iterError, std::fabs(err[i]));
+      }
+      if (iterError < bestError) {
+        best = coefs;
+        bestError = iterError;
+      }
+      std::vector<int> extrema;
+      for (int i = 0; i < numGrid; ++i) {
+        if (!extrema.empty() &&
+            (err[extrema.back()] >= 0) == (err[i] >= 0)) {
+          if (std::fabs(err[i]) > std::fabs(err[extrema.back()]))
+            extrema.back() = i;
+        } else {
+          extrema.push_back(i);
+        }
+      }
+      if ((int)extrema.size() < numNodes)
+        break;
+      while ((int)extrema.size() > numNodes) {
+        if (std::fabs(err[extrema.front()]) < std::fabs(err[extrema.back()]))
+          extrema.erase(extrema.begin());
+        else
+          extrema.pop_back();
+      }
+      double minExtremum = iterError;
+      for (int j = 0; j < numNodes; ++j) {
+        nodes[j] = grid[extrema[j]];
+        minExtremum = std::min(minExtremum, std::fabs(err[extrema[j]]));
+      }
+      // The error is levelled.
+      if (iterError - minExtremum < 1e-3 * iterError)
+        break;
+    }
+    if (maxError != nullptr)
+      *maxError = bestError;
+    return best;
+  }
+
+  /// @brief Returns the plan with the lowest estimated cost that
+  /// approximates f on [a, b] within maxError using at most maxDepth levels.
+  /// @param name     A name that identifies f, used as the cache key.
+  /// @param f        The function.
+  /// @param a, b     The interval.
+  /// @param maxError The maximal allowed approximation error.
+  /// @param maxDepth The available multiplication depth. If negative, the top
+  ///                 chain index of the context is used.
+  /// @param maxDegree The maximal degree to try. Degrees are tried in
+  ///                  increasing order until one meets maxError with some
+  ///                  method that fits in maxDepth. Since the power basis
+  ///                  methods have depths of their own, a degree too deep
+  ///                  for one method doesn't end the search.
+  /// @throw runtime_error If no polynomial up to maxDegree reaches maxError
+  ///                      within maxDepth.
+  ApproximationPlan compile(const std::string& name,
+                            const std::function<double(double)>& f,
+                            double a,
+                            double b,
+                            double maxError,
+                            int maxDepth = -1,
+                            int maxDegree = 127)
+  {
+    if (maxDepth < 0)
+      maxDepth = he.getTopChainIndex();
+    std::string key =
+        getKey(name, a, b, maxError, maxDepth, maxDegree, he.getDefaultScale());
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = plans.find(key);
+      if (it != plans.end())
+        return it->second;
+    }
+    ApproximationPlan res;
+    if (!loadFromDisk(key, res)) {
+      bool found = false;
+      for (int degree = 1; degree <= maxDegree && !found; ++degree) {
+        double error;
+        std::vector<double> coefs = remez(f, degree, a, b, &error);
+        if (error > maxError)
+          continue;
+        res = choosePlan(coefs, a, b, maxError, maxDepth);
+        res.maxError = error;
+        found = res.depth >= 0;
+      }
+      if (!found)
+        throw std::runtime_error("FunctionApproximator: can't approximate " +
+                                 name + " within the given error and depth");
+      saveToDisk(key, res);
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    plans[key] = res;
+    return res;
+  }
+
+  /// @brief Returns p(src), for p and its evaluation method given by plan.
+  CTile evaluate(const CTile& src, const ApproximationPlan& plan) const
+  {
+    if (plan.method == CHEBYSHEV_PS) {
+      ChebyshevEvaluator ce(he);
+      return ce.evaluate(src, plan.chebyshevCoefs, plan.a, plan.b);
+    }
+    FunctionEvaluator fe(he);
+    CTile res(src);
+    if (plan.method == POWER_PS)
+      fe.polyEvalInPlace(res, plan.powerCoefs, PATERSONSTOCKMAYER);
+    else if (plan.method == POWER_EFFICIENT_POWERS)
+      fe.efficientPowersPolyEvalInPlace(res, plan.powerCoefs);
+    else
+      fe.minDepthPolyEvalInPlace(res, plan.powerCoefs);
+    return res;
+  }
+
+  /// @brief Returns p(src) element-wise, evaluating the tiles in parallel.
+  /// Unused slots of the result are marked unknown.
+  CTileTensor evaluate(const CTileTensor& src,
+                       const ApproximationPlan& plan) const
+  {
+    std::vector<CTile> tiles(src.getNumUsedTiles(), CTile(he));
+    parallelFor(0, src.getNumUsedTiles(), [&](int t) {
+      tiles[t] = evaluate(src.getTileByFlatIndex(t), plan);
+    });
+    TTShape shape(src.getShape());
+    shape.setAllUnusedSlotsUnknown();
+    return CTileTensor::createFromCTileVector(he, shape, tiles);
+  }
+};
+
+} // namespace helayers
+
+#endif /* TUTORIALS_FUNCTION_APPROXIMATOR_H */
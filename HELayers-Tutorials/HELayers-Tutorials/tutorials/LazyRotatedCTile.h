@@ -0,0 +1,173 @@
+//
+//  LazyRotatedCTile.h
+//  HELayers-Tutorials
+//
+
+#ifndef TUTORIALS_LAZY_ROTATED_CTILE_H
+#define TUTORIALS_LAZY_ROTATED_CTILE_H
+
+#include <cstdlib>
+#include <vector>
+
+#include "helayers/hebase/CTile.h"
+#include "helayers/hebase/Encoder.h"
+
+namespace helayers {
+
+/// @brief A CTile with a pending rotation. Its logical value is the held
+/// ciphertext rotated by the pending offset, as in CTile::rotate().
+///
+/// rotate() only updates the offset, so consecutive rotations are combined
+/// into one, and rotations summing to zero (mod the slot count) cost nothing.
+/// The real rotation happens only when the value is needed. Element-wise
+/// operations between two lazy tiles with different offsets rotate just one
+/// operand, to match the other, whichever leaves the cheaper rotation
+/// pending. Offsets are kept in (-n/2, n/2], so rotations go the short way.
+/// Plaintext values are rotated on the client side before encoding, so
+/// multiplying by them needs no rotation at all.
+class LazyRotatedCTile
+{
+  CTile tile;
+  int offset = 0;
+
+  // Number of rotations actually performed.
+  int numRotations = 0;
+
+  // Returns the rotation equivalent to "rot" in (-n/2, n/2], which rotates
+  // the shorter way.
+  int normalize(int rot) const
+  {
+    int n = tile.slotCount();
+    int res = ((rot % n) + n) % n;
+    return res > n / 2 ? res - n : res;
+  }
+
+  // Returns the number of key switches of a rotation by "rot", with rotation
+  // keys for the powers of 2 in both directions: the number of nonzero digits
+  // of its non-adjacent form.
+  static int getRotationCost(int rot)
+  {
+    int res = 0;
+    for (int r = std::abs(rot); r != 0; r >>= 1)
+      if (r & 1) {
+        ++res;
+        r = (r & 2) ? r + 1 : r - 1;
+      }
+    return res;
+  }
+
+  // Returns the ciphertext of "other" at this offset, rotating one of the two
+  // operands once. Rotating either one takes the same rotation, so the one
+  // rotated is the one that leaves the cheaper rotation pending. "scratch"
+  // holds the result if it's a rotated copy of "other".
+  const CTile& getAligned(const LazyRotatedCTile& other, CTile& scratch)
+  {
+    if (offset == other.offset)
+      return other.tile;
+    ++numRotations;
+    if (getRotationCost(other.offset) <= getRotationCost(offset)) {
+      tile.rotate(normalize(offset - other.offset));
+      offset = other.offset;
+      return other.tile;
+    }
+    scratch = other.tile;
+    scratch.rotate(normalize(other.offset - offset));
+    return scratch;
+  }
+
+  // Encodes plaintext values rotated against the offset, so they line up
+  // with the held ciphertext.
+  PTile encodeAligned(const std::vector<double>& vals)
+  {
+    int n = tile.slotCount();
+    std::vector<double> aligned(n, 0);
+    for (size_t i = 0; i < vals.size(); ++i)
+      aligned[((i + offset) % n + n) % n] = vals[i];
+    Encoder enc(tile.getHeContext());
+    PTile res(tile.getHeContext());
+    enc.encode(res, aligned, tile.getChainIndex());
+    return res;
+  }
+
+public:
+  /// @brief Constructs a lazy tile with no pending rotation.
+  explicit LazyRotatedCTile(const CTile& src) : tile(src) {}
+
+  /// @brief Constructs a lazy tile taking over the given CTile.
+  explicit LazyRotatedCTile(CTile&& src) : tile(std::move(src)) {}
+
+  /// @brief Rotates the logical value by "rot" slots. No ciphertext
+  /// operation is done.
+  void rotate(int rot) { offset = normalize(offset + rot); }
+
+  /// @brief Performs the pending rotation, if any.
+  void materialize()
+  {
+    if (offset == 0)
+      return;
+    tile.rotate(offset);
+    offset = 0;
+    ++numRotations;
+  }
+
+  /// @brief Returns the logical value, performing the pending rotation if
+  /// needed.
+  const CTile& get()
+  {
+    materialize();
+    return tile;
+  }
+
+  /// @brief Adds "other". If the offsets differ, one of the two is rotated to
+  /// match the other.
+  void add(const LazyRotatedCTile& other)
+  {
+    CTile scratch(tile.getHeContext());
+    tile.add(getAligned(other, scratch));
+  }
+
+  /// @brief Subtracts "other". See add().
+  void sub(const LazyRotatedCTile& other)
+  {
+    CTile scratch(tile.getHeContext());
+    tile.sub(getAligned(other, scratch));
+  }
+
+  /// @brief Multiplies by "other". See add().
+  void multiply(const LazyRotatedCTile& other)
+  {
+    CTile scratch(tile.getHeContext());
+    tile.multiply(getAligned(other, scratch));
+  }
+
+  /// @brief Multiplies by the given plaintext values, without performing the
+  /// pending rotation. The values are rotated against the offset before being
+  /// encoded.
+  void multiplyPlain(const std::vector<double>& vals)
+  {
+    tile.multiplyPlain(encodeAligned(vals));
+  }
+
+  /// @brief Adds the given plaintext values. See multiplyPlain().
+  void addPlain(const std::vector<double>& vals)
+  {
+    tile.addPlain(encodeAligned(vals));
+  }
+
+  // Slot-wise operations that don't depend on the rotation.
+  void addScalar(double val) { tile.addScalar(val); }
+  void multiplyScalar(double val) { tile.multiplyScalar(val); }
+  void negate() { tile.negate(); }
+  void square() { tile.square(); }
+
+  /// @brief Returns the pending rotation.
+  int getOffset() const { return offset; }
+
+  /// @brief Returns the number of rotations actually performed by this
+  /// object.
+  int getNumRotations() const { return numRotations; }
+};
+
+} // namespace helayers
+
+#endif /* TUTORIALS_LAZY_ROTATED_CTILE_H */
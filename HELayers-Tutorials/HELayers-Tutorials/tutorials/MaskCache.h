@@ -0,0 +1,179 @@
+//
+//  MaskCache.h
+//  HELayers-Tutorials
+//
+
+#ifndef TUTORIALS_MASK_CACHE_H
+#define TUTORIALS_MASK_CACHE_H
+
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "helayers/hebase/Encoder.h"
+#include "helayers/hebase/PTile.h"
+
+namespace helayers {
+
+/// @brief Interns encoded masks, so that each distinct mask is encoded only
+/// once per chain index and scale, and shared by all its users.
+///
+/// Masks are mostly 0/1 patterns that repeat across tiles, layers and calls.
+/// The cache is keyed by the mask values, the chain index and the scale. It
+/// holds at most maxSize masks and evicts the least recently used one when
+/// full. Masks handed out remain valid after eviction, since they are shared.
+/// The cache is thread safe.
+class MaskCache
+{
+  struct Key
+  {
+    size_t hash;
+    int chainIndex;
+    double scale;
+    std::vector<double> vals;
+
+    bool operator<(const Key& other) const
+    {
+      // Compare the cheap fields first, so the values are compared only on
+      // an exact match (or a hash collision).
+      if (hash != other.hash)
+        return hash < other.hash;
+      if (chainIndex != other.chainIndex)
+        return chainIndex < other.chainIndex;
+      if (scale != other.scale)
+        return scale < other.scale;
+      return vals < other.vals;
+    }
+  };
+
+  typedef std::list<std::pair<Key, std::shared_ptr<const PTile>>> LruList;
+
+  const HeContext& he;
+  size_t maxSize;
+
+  // Most recently used first.
+  LruList lru;
+  std::map<Key, LruList::iterator> index;
+
+  int64_t numHits = 0;
+  int64_t numMisses = 0;
+  mutable std::mutex mtx;
+
+  static size_t hashValues(const std::vector<double>& vals)
+  {
+    size_t res = vals.size();
+    std::hash<double> hasher;
+    for (double v : vals)
+      res ^= hasher(v) + 0x9e3779b97f4a7c15ULL + (res << 6) + (res >> 2);
+    return res;
+  }
+
+public:
+  /// @brief A constructor.
+  /// @param he      The HeContext.
+  /// @param maxSize The maximal number of masks to hold.
+  MaskCache(const HeContext& he, size_t maxSize = 1024)
+      : he(he), maxSize(maxSize)
+  {
+    always_assert(maxSize > 0);
+  }
+
+  /// @brief Returns the given values encoded at the given chain index and
+  /// scale, encoding them only if they're not in the cache.
+  /// @param vals       The mask values. Missing slots are zero.
+  /// @param chainIndex The chain index, or -1 for the top of the chain.
+  /// @param scale      The scale, or -1 for the default scale.
+  std::shared_ptr<const PTile> getMask(const std::vector<double>& vals,
+                                       int chainIndex = -1,
+                                       double scale = -1)
+  {
+    if (chainIndex == -1)
+      chainIndex = he.getTopChainIndex();
+    Key key{hashValues(vals), chainIndex, scale, vals};
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      auto it = index.find(key);
+      if (it != index.end()) {
+        ++numHits;
+        lru.splice(lru.begin(), lru, it->second);
+        return it->second->second;
+      }
+      ++numMisses;
+    }
+
+    // Encode outside the lock, so other threads aren't blocked. Two threads
+    // missing the same mask may both encode it; the first one is kept.
+    Encoder enc(he);
+    if (scale > 0)
+      enc.setDefaultScale(scale);
+    auto mask = std::make_shared<PTile>(he);
+    enc.encode(*mask, vals, chainIndex);
+
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = index.find(key);
+    if (it != index.end())
+      return it->second->second;
+    lru.emplace_front(key, mask);
+    index[key] = lru.begin();
+    if (lru.size() > maxSize) {
+      index.erase(lru.back().first);
+      lru.pop_back();
+    }
+    return mask;
+  }
+
+  /// @brief Returns a mask holding "val" in the first "numUsed" slots and
+  /// zero in the rest.
+  std::shared_ptr<const PTile> getPrefixMask(int numUsed,
+                                             int chainIndex = -1,
+                                             double val = 1,
+                                             double scale = -1)
+  {
+    return getMask(std::vector<double>(numUsed, val), chainIndex, scale);
+  }
+
+  /// @brief Returns a mask holding "val" in all slots.
+  std::shared_ptr<const PTile> getScalarMask(double val,
+                                             int chainIndex = -1,
+                                             double scale = -1)
+  {
+    return getPrefixMask(he.slotCount(), chainIndex, val, scale);
+  }
+
+  /// @brief Removes all masks and resets the counters.
+  void clear()
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    lru.clear();
+    index.clear();
+    numHits = 0;
+    numMisses = 0;
+  }
+
+  /// @brief Returns the number of masks held.
+  size_t size() const
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    return lru.size();
+  }
+
+  /// @brief Returns the number of calls that found their mask in the cache.
+  int64_t getNumHits() const
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    return numHits;
+  }
+
+  /// @brief Returns the number of calls that had to encode their mask.
+  int64_t getNumMisses() const
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    return numMisses;
+  }
+};
+
+} // namespace helayers
+
+#endif /* TUTORIALS_MASK_CACHE_H */
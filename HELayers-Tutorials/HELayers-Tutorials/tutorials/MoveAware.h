@@ -0,0 +1,250 @@
+//
+//  MoveAware.h
+//  HELayers-Tutorials
+//
+
+#ifndef TUTORIALS_MOVE_AWARE_H
+#define TUTORIALS_MOVE_AWARE_H
+
+#include <utility>
+#include <vector>
+
+#include "helayers/math/CTileTensor.h"
+#include "helayers/math/TTFunctionEvaluator.h"
+
+namespace helayers {
+
+/// Out-of-place tile tensor operations that reuse the storage of temporary
+/// operands.
+///
+/// The CTileTensor::getX() methods copy the receiver and then operate on the
+/// copy in place. When the receiver is a temporary, as in
+/// a.getAdd(b).getMultiply(c), the copy is wasted. The functions below take
+/// their tensor argument by value: passing a temporary (or std::move()-ing a
+/// tensor that's no longer needed) moves it in, so the operation is done in
+/// place on its storage, and passing an lvalue copies it as getX() does.
+/// Chains of calls on temporaries thus never copy a tensor:
+///
+///   CTileTensor res = getSumOverDim(getMultiply(getAdd(a, b), c), 1);
+///
+/// For commutative operations, the second operand's storage is reused when
+/// only it is a temporary.
+
+inline CTileTensor getAdd(CTileTensor a, const CTileTensor& b)
+{
+  a.add(b);
+  return a;
+}
+
+inline CTileTensor getAdd(const CTileTensor& a, CTileTensor&& b)
+{
+  b.add(a);
+  return std::move(b);
+}
+
+inline CTileTensor getAdd(CTileTensor&& a, CTileTensor&& b)
+{
+  a.add(b);
+  return std::move(a);
+}
+
+inline CTileTensor getSub(CTileTensor a, const CTileTensor& b)
+{
+  a.sub(b);
+  return a;
+}
+
+inline CTileTensor getMultiply(CTileTensor a, const CTileTensor& b)
+{
+  a.multiply(b);
+  return a;
+}
+
+inline CTileTensor getMultiply(const CTileTensor& a, CTileTensor&& b)
+{
+  b.multiply(a);
+  return std::move(b);
+}
+
+inline CTileTensor getMultiply(CTileTensor&& a, CTileTensor&& b)
+{
+  a.multiply(b);
+  return std::move(a);
+}
+
+// Operations with a plaintext operand. The ciphertext operand's storage is
+// reused, whichever side of a commutative operation it's on.
+
+inline CTileTensor getAddPlain(CTileTensor a, const PTileTensor& p)
+{
+  a.addPlain(p);
+  return a;
+}
+
+inline CTileTensor getAddPlain(const PTileTensor& p, CTileTensor a)
+{
+  a.addPlain(p);
+  return a;
+}
+
+inline CTileTensor getAddPlainRaw(CTileTensor a, const PTileTensor& p)
+{
+  a.addPlainRaw(p);
+  return a;
+}
+
+inline CTileTensor getSubPlain(CTileTensor a, const PTileTensor& p)
+{
+  a.subPlain(p);
+  return a;
+}
+
+inline CTileTensor getSubPlainRaw(CTileTensor a, const PTileTensor& p)
+{
+  a.subPlainRaw(p);
+  return a;
+}
+
+inline CTileTensor getMultiplyPlain(CTileTensor a, const PTileTensor& p)
+{
+  a.multiplyPlain(p);
+  return a;
+}
+
+inline CTileTensor getMultiplyPlain(const PTileTensor& p, CTileTensor a)
+{
+  a.multiplyPlain(p);
+  return a;
+}
+
+inline CTileTensor getMultiplyPlainRaw(CTileTensor a, const PTileTensor& p)
+{
+  a.multiplyPlainRaw(p);
+  return a;
+}
+
+inline CTileTensor getAddScalar(CTileTensor a, double val)
+{
+  a.addScalar(val);
+  return a;
+}
+
+inline CTileTensor getMultiplyScalar(CTileTensor a, double val)
+{
+  a.multiplyScalar(val);
+  return a;
+}
+
+inline CTileTensor getSquare(CTileTensor a)
+{
+  a.square();
+  return a;
+}
+
+inline CTileTensor getNegate(CTileTensor a)
+{
+  a.negate();
+  return a;
+}
+
+inline CTileTensor getRescale(CTileTensor a)
+{
+  a.rescale();
+  return a;
+}
+
+inline CTileTensor getRelinearizeAndRescale(CTileTensor a)
+{
+  a.relinearizeAndRescale();
+  return a;
+}
+
+inline CTileTensor getSumOverDim(CTileTensor a, int dim)
+{
+  a.sumOverDim(dim);
+  return a;
+}
+
+inline CTileTensor getMultiplyOverDim(CTileTensor a, int dim)
+{
+  a.multiplyOverDim(dim);
+  return a;
+}
+
+inline CTileTensor getDuplicateOverDim(CTileTensor a, int dim)
+{
+  a.duplicateOverDim(dim);
+  return a;
+}
+
+inline CTileTensor getMultiplyAndSum(CTileTensor a,
+                                     const CTileTensor& b,
+                                     int sumDim)
+{
+  a.multiplyAndSum(b, sumDim);
+  return a;
+}
+
+inline CTileTensor getMultiplyPlainAndSum(CTileTensor a,
+                                          const PTileTensor& p,
+                                          int sumDim)
+{
+  a.multiplyPlainAndSum(p, sumDim);
+  return a;
+}
+
+inline CTileTensor getReorderDims(CTileTensor a,
+                                  const std::vector<DimInt>& dimOrder)
+{
+  a.reorderDims(dimOrder);
+  return a;
+}
+
+inline CTileTensor getClearUnknowns(CTileTensor a)
+{
+  a.clearUnknowns();
+  return a;
+}
+
+/// @brief Returns src evaluated in the given polynomial. See
+/// TTFunctionEvaluator::polyEvalInPlace().
+inline CTileTensor getPolyEval(const TTFunctionEvaluator& fe,
+                               CTileTensor src,
+                               const std::vector<double>& coefs)
+{
+  fe.polyEvalInPlace(src, coefs);
+  return src;
+}
+
+/// @brief Returns the sign of src. See TTFunctionEvaluator::signInPlace().
+inline CTileTensor getSign(const TTFunctionEvaluator& fe,
+                           CTileTensor src,
+                           int gRep,
+                           int fRep)
+{
+  fe.signInPlace(src, gRep, fRep);
+  return src;
+}
+
+/// @brief Returns src raised to the given power. See
+/// TTFunctionEvaluator::powInPlace().
+inline CTileTensor getPow(const TTFunctionEvaluator& fe,
+                          CTileTensor src,
+                          int degree)
+{
+  fe.powInPlace(src, degree);
+  return src;
+}
+
+/// @brief Returns the sigmoid of src. See
+/// TTFunctionEvaluator::sigmoid3InPlace().
+inline CTileTensor getSigmoid3(const TTFunctionEvaluator& fe,
+                               CTileTensor src)
+{
+  fe.sigmoid3InPlace(src);
+  return src;
+}
+
+} // namespace helayers
+
+#endif /* TUTORIALS_MOVE_AWARE_H */
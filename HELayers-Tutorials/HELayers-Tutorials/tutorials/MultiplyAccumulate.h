@@ -0,0 +1,155 @@
+//
+//  MultiplyAccumulate.h
+//  HELayers-Tutorials
+//
+
+#ifndef TUTORIALS_MULTIPLY_ACCUMULATE_H
+#define TUTORIALS_MULTIPLY_ACCUMULATE_H
+
+#include "helayers/hebase/CTile.h"
+#include "helayers/math/CTileTensor.h"
+
+namespace helayers {
+
+/// @brief Computes acc += a * b, without relinearizing or rescaling the
+/// product. acc must be a raw accumulator, i.e., a sum of raw products at the
+/// same chain index and scale. Call relinearize() and rescale() on acc once
+/// the accumulation is complete.
+inline void multiplyAddRaw(CTile& acc, const CTile& a, const CTile& b)
+{
+  CTile prod(a);
+  prod.multiplyRaw(b);
+  acc.addRaw(prod);
+}
+
+/// @brief Computes acc += a * p, without rescaling the product. See
+/// multiplyAddRaw().
+inline void multiplyPlainAddRaw(CTile& acc, const CTile& a, const PTile& p)
+{
+  CTile prod(a);
+  prod.multiplyPlainRaw(p);
+  acc.addRaw(prod);
+}
+
+/// @brief Computes acc += a * b, where acc is a regular (relinearized and
+/// rescaled) ciphertext.
+inline void multiplyAdd(CTile& acc, const CTile& a, const CTile& b)
+{
+  CTile prod(a);
+  prod.multiply(b);
+  acc.add(prod);
+}
+
+/// @brief Computes acc += a * p, where acc is a regular (rescaled)
+/// ciphertext.
+inline void multiplyPlainAdd(CTile& acc, const CTile& a, const PTile& p)
+{
+  CTile prod(a);
+  prod.multiplyPlain(p);
+  acc.add(prod);
+}
+
+/// @brief Computes acc += a * b element-wise, without relinearizing or
+/// rescaling. Call relinearizeAndRescale() on acc once the accumulation is
+/// complete.
+inline void multiplyAddRaw(CTileTensor& acc,
+                           const CTileTensor& a,
+                           const CTileTensor& b)
+{
+  acc.addRaw(a.getMultiplyRaw(b));
+}
+
+/// @brief Computes acc += a * p element-wise, without rescaling. See
+/// multiplyAddRaw().
+inline void multiplyPlainAddRaw(CTileTensor& acc,
+                                const CTileTensor& a,
+                                const PTileTensor& p)
+{
+  acc.addRaw(a.getMultiplyPlainRaw(p));
+}
+
+/// @brief Computes acc += a * b element-wise, where acc is a regular
+/// (relinearized and rescaled) tensor.
+inline void multiplyAdd(CTileTensor& acc,
+                        const CTileTensor& a,
+                        const CTileTensor& b)
+{
+  acc.add(a.getMultiply(b));
+}
+
+/// @brief Computes acc += a * p element-wise, where acc is a regular
+/// (rescaled) tensor.
+inline void multiplyPlainAdd(CTileTensor& acc,
+                             const CTileTensor& a,
+                             const PTileTensor& p)
+{
+  acc.add(a.getMultiplyPlain(p));
+}
+
+/// @brief Accumulates a sum of products, relinearizing and rescaling only
+/// once, when the result is taken. Summing n products this way costs one
+/// relinearization and one rescale instead of n of each.
+///
+/// All multiplied operands must be at the same chain index, and plaintexts
+/// must be encoded at the default scale, so all products share the same
+/// scale.
+class MultiplyAccumulator
+{
+  const HeContext& he;
+  CTile acc;
+  bool empty = true;
+  bool needsRelinearize = false;
+
+public:
+  /// @brief A constructor.
+  /// @param he The HeContext.
+  MultiplyAccumulator(const HeContext& he) : he(he), acc(he) {}
+
+  /// @brief Adds a * b to the sum.
+  void multiplyAdd(const CTile& a, const CTile& b)
+  {
+    if (empty) {
+      acc = a;
+      acc.multiplyRaw(b);
+      empty = false;
+    } else {
+      multiplyAddRaw(acc, a, b);
+    }
+    needsRelinearize = true;
+  }
+
+  /// @brief Adds a * p to the sum.
+  void multiplyPlainAdd(const CTile& a, const PTile& p)
+  {
+    if (empty) {
+      acc = a;
+      acc.multiplyPlainRaw(p);
+      empty = false;
+    } else {
+      multiplyPlainAddRaw(acc, a, p);
+    }
+  }
+
+  /// @brief Returns the accumulated sum, relinearized and rescaled, and
+  /// resets the accumulator.
+  CTile getResult()
+  {
+    if (empty)
+      throw std::runtime_error("MultiplyAccumulator: nothing was accumulated");
+    if (needsRelinearize)
+      acc.relinearize();
+    acc.rescale();
+    CTile res(std::move(acc));
+    acc = CTile(he);
+    empty = true;
+    needsRelinearize = false;
+    return res;
+  }
+
+  /// @brief Returns whether nothing was accumulated since the last reset.
+  bool isEmpty() const { return empty; }
+};
+
+} // namespace helayers
+
+#endif /* TUTORIALS_MULTIPLY_ACCUMULATE_H */
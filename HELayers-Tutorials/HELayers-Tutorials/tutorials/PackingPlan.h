@@ -0,0 +1,177 @@
+//
+//  PackingPlan.h
+//  HELayers-Tutorials
+//
+
+#ifndef TUTORIALS_PACKING_PLAN_H
+#define TUTORIALS_PACKING_PLAN_H
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include "helayers/math/CTileTensor.h"
+#include "ParallelFor.h"
+#include "SlotMaps.h"
+
+namespace helayers {
+
+/// @brief A precomputed mapping between the elements of a tensor and the
+/// slots of its tiles, for a given tile tensor shape.
+///
+/// TTEncoder works out the tile and slot of every element on each call, by
+/// iterating over the shape. A PackingPlan finds them once, and then packs a
+/// tensor by gathering its elements into each tile with a flat index array,
+/// and unpacks it by scattering them back. The tiles are packed, encrypted
+/// and decrypted in parallel.
+class PackingPlan
+{
+  TTShape shape;
+  std::vector<DimInt> originalSizes;
+
+  // gather[t][s] is the flat (first order) index of the element held by slot
+  // s of tile t, or -1 if the slot holds no element.
+  std::vector<std::vector<int64_t>> gather;
+
+  // scatter[e] is the flat tile-slot position (t * slotCount + s) from which
+  // element e is unpacked. Duplicated elements are taken from their first
+  // slot.
+  std::vector<int64_t> scatter;
+
+  int slotCount;
+
+public:
+  /// @brief Builds the plan for the given shape, whose original sizes must be
+  /// set.
+  PackingPlan(const HeContext& he, const TTShape& shape)
+      : shape(shape),
+        originalSizes(shape.getOriginalSizes()),
+        gather(getSlotElementMap(he, shape)),
+        slotCount(he.slotCount())
+  {
+    int64_t numElements = 1;
+    for (DimInt s : originalSizes)
+      numElements *= s;
+    scatter.assign(numElements, -1);
+    for (size_t t = 0; t < gather.size(); ++t)
+      for (size_t s = 0; s < gather[t].size(); ++s) {
+        int64_t e = gather[t][s];
+        if (e >= 0 && scatter[e] < 0)
+          scatter[e] = t * slotCount + s;
+      }
+  }
+
+  /// @brief Returns the slot values of each tile for the given tensor.
+  std::vector<std::vector<double>> pack(const DoubleTensor& src) const
+  {
+    always_assert(src.getShape() == originalSizes);
+    const double* data = &src.getTensor()[0];
+    std::vector<std::vector<double>> res(gather.size());
+    parallelFor(0, (int)gather.size(), [&](int t) {
+      const std::vector<int64_t>& g = gather[t];
+      res[t].resize(g.size());
+      for (size_t s = 0; s < g.size(); ++s)
+        res[t][s] = g[s] >= 0 ? data[g[s]] : 0;
+    });
+    return res;
+  }
+
+  /// @brief Encodes and encrypts the given tensor, as in
+  /// TTEncoder::encodeEncrypt().
+  CTileTensor encodeEncrypt(const HeContext& he,
+                            const DoubleTensor& src,
+                            int chainIndex = -1) const
+  {
+    std::vector<std::vector<double>> vals = pack(src);
+    std::vector<CTile> tiles(vals.size(), CTile(he));
+    parallelFor(0, (int)vals.size(), [&](int t) {
+      Encoder enc(he);
+      enc.encodeEncrypt(tiles[t], vals[t], chainIndex);
+    });
+    return CTileTensor::createFromCTileVector(he, shape, tiles);
+  }
+
+  /// @brief Returns the tensor held by the given slot values of each tile.
+  DoubleTensor unpack(const std::vector<std::vector<double>>& vals) const
+  {
+    always_assert(vals.size() == gather.size());
+    DoubleTensor res(originalSizes);
+    double* data = &res.getTensor()[0];
+    // The elements are scattered in chunks of a tile's size, so each thread
+    // gets enough work per index.
+    int64_t numElements = (int64_t)scatter.size();
+    int numChunks = (int)((numElements + slotCount - 1) / slotCount);
+    parallelFor(0, numChunks, [&](int c) {
+      int64_t end = std::min(numElements, (int64_t)(c + 1) * slotCount);
+      for (int64_t e = (int64_t)c * slotCount; e < end; ++e)
+        data[e] = vals[scatter[e] / slotCount][scatter[e] % slotCount];
+    });
+    return res;
+  }
+
+  /// @brief Decrypts and decodes the given tile tensor, as in
+  /// TTEncoder::decryptDecodeDouble().
+  DoubleTensor decryptDecode(const HeContext& he, const CTileTensor& src) const
+  {
+    always_assert(src.getNumUsedTiles() == (int)gather.size());
+    std::vector<std::vector<double>> vals(gather.size());
+    parallelFor(0, (int)vals.size(), [&](int t) {
+      Encoder enc(he);
+      vals[t] = enc.decryptDecodeDouble(src.getTileByFlatIndex(t));
+    });
+    return unpack(vals);
+  }
+
+  const TTShape& getShape() const { return shape; }
+};
+
+/// @brief A thread safe cache of packing plans, keyed by shape.
+class PackingPlanCache
+{
+  const HeContext& he;
+  std::map<std::string, std::shared_ptr<const PackingPlan>> plans;
+  std::mutex lock;
+
+public:
+  PackingPlanCache(const HeContext& he) : he(he) {}
+
+  /// @brief Returns the plan for the given shape, building it on first use.
+  std::shared_ptr<const PackingPlan> getPlan(const TTShape& shape)
+  {
+    std::stringstream key;
+    shape.save(key);
+    std::lock_guard<std::mutex> guard(lock);
+    std::shared_ptr<const PackingPlan>& plan = plans[key.str()];
+    if (!plan)
+      plan = std::make_shared<PackingPlan>(he, shape);
+    return plan;
+  }
+
+  /// @brief Encodes and encrypts the given tensor with the given shape.
+  CTileTensor encodeEncrypt(const TTShape& shape,
+                            const DoubleTensor& src,
+                            int chainIndex = -1)
+  {
+    return getPlan(shape)->encodeEncrypt(he, src, chainIndex);
+  }
+
+  /// @brief Decrypts and decodes the given tile tensor.
+  DoubleTensor decryptDecode(const CTileTensor& src)
+  {
+    return getPlan(src.getShape())->decryptDecode(he, src);
+  }
+
+  /// @brief Returns the number of plans held.
+  size_t size()
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    return plans.size();
+  }
+};
+
+} // namespace helayers
+
+#endif /* TUTORIALS_PACKING_PLAN_H */
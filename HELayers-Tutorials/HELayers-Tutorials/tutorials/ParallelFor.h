@@ -0,0 +1,77 @@
+//
+//  ParallelFor.h
+//  HELayers-Tutorials
+//
+
+#ifndef TUTORIALS_PARALLEL_FOR_H
+#define TUTORIALS_PARALLEL_FOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <future>
+#include <thread>
+#include <vector>
+
+namespace helayers {
+
+// The app isn't built with OpenMP, and iOS ships no OpenMP runtime, so the
+// tutorials run their independent loops on std::async threads instead.
+
+/// @brief Returns the number of threads to run n independent tasks on: the
+/// hardware concurrency, but no more than n and at least 1.
+inline int getNumWorkers(int n)
+{
+  int hw = (int)std::thread::hardware_concurrency();
+  return std::max(1, std::min(n, hw > 0 ? hw : 1));
+}
+
+/// @brief Runs body(w) for every w in [0, numWorkers), each on its own
+/// thread, w = 0 on the caller's. Returns when all are done, rethrowing the
+/// first exception any of them threw.
+inline void runWorkers(int numWorkers, const std::function<void(int)>& body)
+{
+  std::vector<std::future<void>> others;
+  for (int w = 1; w < numWorkers; ++w)
+    others.push_back(std::async(std::launch::async, body, w));
+  std::exception_ptr error;
+  try {
+    body(0);
+  } catch (...) {
+    error = std::current_exception();
+  }
+  for (std::future<void>& f : others) {
+    try {
+      f.get();
+    } catch (...) {
+      if (!error)
+        error = std::current_exception();
+    }
+  }
+  if (error)
+    std::rethrow_exception(error);
+}
+
+/// @brief Runs body(i) for every i in [begin, end) on getNumWorkers()
+/// threads. The indices are handed out one at a time, so iterations of
+/// uneven cost balance out. The iterations must be independent.
+inline void parallelFor(int begin,
+                        int end,
+                        const std::function<void(int)>& body)
+{
+  if (end - begin <= 1) {
+    for (int i = begin; i < end; ++i)
+      body(i);
+    return;
+  }
+  std::atomic<int> next(begin);
+  runWorkers(getNumWorkers(end - begin), [&](int) {
+    for (int i = next++; i < end; i = next++)
+      body(i);
+  });
+}
+
+} // namespace helayers
+
+#endif /* TUTORIALS_PARALLEL_FOR_H */
@@ -0,0 +1,175 @@
+//
+//  PlainKernels.h
+//  HELayers-Tutorials
+//
+
+#ifndef TUTORIALS_PLAIN_KERNELS_H
+#define TUTORIALS_PLAIN_KERNELS_H
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "helayers/math/DoubleTensor.h"
+#include "helayers/math/Padding2d.h"
+#include "ParallelFor.h"
+
+namespace helayers {
+
+/// Fast plaintext kernels for DoubleTensor, for preparing inputs and
+/// validating encrypted results on the client.
+///
+/// The DoubleTensor methods visit elements one by one through iterators. The
+/// kernels below work directly on the underlying first order buffer (first
+/// dim runs fastest), in cache-sized blocks, with inner loops over
+/// contiguous memory that the compiler can vectorize. Independent blocks
+/// are spread over all cores with parallelFor(). The results match the
+/// DoubleTensor methods up to floating point rounding.
+
+namespace plain_kernels {
+
+const DimInt blockSize = 64;
+
+inline const double* data(const DoubleTensor& t) { return &t.getTensor()[0]; }
+inline double* data(DoubleTensor& t) { return &t.getTensor()[0]; }
+
+} // namespace plain_kernels
+
+/// @brief Returns the product of two matrices, a [n, k] and b [k, m], as in
+/// DoubleTensor::getMatrixMultiply().
+inline DoubleTensor fastMatrixMultiply(const DoubleTensor& a,
+                                       const DoubleTensor& b)
+{
+  using namespace plain_kernels;
+  if (a.order() != 2 || b.order() != 2 || a.getDimSize(1) != b.getDimSize(0))
+    throw std::invalid_argument("fastMatrixMultiply: incompatible shapes " +
+                                a.getShapeAsString() + " and " +
+                                b.getShapeAsString());
+  DimInt n = a.getDimSize(0), k = a.getDimSize(1), m = b.getDimSize(1);
+  DoubleTensor res({n, m});
+  const double* aData = data(a);
+  const double* bData = data(b);
+  double* resData = data(res);
+
+  // res(:, j) += a(:, l) * b(l, j). Columns are contiguous in the first
+  // order layout, so the inner loop is a vectorizable axpy. Blocks of l
+  // keep a block of a's columns in cache while they're reused for a block
+  // of res's columns. Column blocks of res are independent.
+  DimInt numColBlocks = (m + blockSize - 1) / blockSize;
+  parallelFor(0, numColBlocks, [&](DimInt jb) {
+    DimInt jEnd = std::min(m, (jb + 1) * blockSize);
+    for (DimInt lb = 0; lb < k; lb += blockSize) {
+      DimInt lEnd = std::min(k, lb + blockSize);
+      for (DimInt j = jb * blockSize; j < jEnd; ++j) {
+        double* resCol = resData + j * n;
+        for (DimInt l = lb; l < lEnd; ++l) {
+          double w = bData[l + k * j];
+          const double* aCol = aData + l * n;
+          for (DimInt i = 0; i < n; ++i)
+            resCol[i] += aCol[i] * w;
+        }
+      }
+    }
+  });
+  return res;
+}
+
+/// @brief Returns the transpose of a matrix, as in DoubleTensor::transpose().
+inline DoubleTensor fastTranspose(const DoubleTensor& a)
+{
+  using namespace plain_kernels;
+  if (a.order() != 2)
+    throw std::invalid_argument("fastTranspose: expected a matrix, got " +
+                                a.getShapeAsString());
+  DimInt n = a.getDimSize(0), m = a.getDimSize(1);
+  DoubleTensor res({m, n});
+  const double* src = data(a);
+  double* dst = data(res);
+
+  // Copy square blocks, so both the reads and the strided writes stay in
+  // cache.
+  DimInt numColBlocks = (m + blockSize - 1) / blockSize;
+  parallelFor(0, numColBlocks, [&](DimInt jb) {
+    DimInt jEnd = std::min(m, (jb + 1) * blockSize);
+    for (DimInt ib = 0; ib < n; ib += blockSize) {
+      DimInt iEnd = std::min(n, ib + blockSize);
+      for (DimInt j = jb * blockSize; j < jEnd; ++j)
+        for (DimInt i = ib; i < iEnd; ++i)
+          dst[j + m * i] = src[i + n * j];
+    }
+  });
+  return res;
+}
+
+/// @brief Returns the convolution of an input [X, Y, CHANNELS, BATCH] with
+/// filters [FILTERX, FILTERY, CHANNELS, FILTERS], as in
+/// DoubleTensor::calcConvolution(). The result is [OUTX, OUTY, FILTERS,
+/// BATCH]. The up and down paddings apply to X, and the left and right
+/// paddings to Y.
+inline DoubleTensor fastConvolution(const DoubleTensor& input,
+                                    const DoubleTensor& filters,
+                                    const DoubleTensor& biases,
+                                    DimInt strideX = 1,
+                                    DimInt strideY = 1,
+                                    const Padding2d& padding = Padding2d())
+{
+  using namespace plain_kernels;
+  if (input.order() != 4 || filters.order() != 4 ||
+      input.getDimSize(2) != filters.getDimSize(2))
+    throw std::invalid_argument("fastConvolution: incompatible shapes " +
+                                input.getShapeAsString() + " and " +
+                                filters.getShapeAsString());
+  DimInt x = input.getDimSize(0), y = input.getDimSize(1);
+  DimInt c = input.getDimSize(2), batch = input.getDimSize(3);
+  DimInt fx = filters.getDimSize(0), fy = filters.getDimSize(1);
+  DimInt numFilters = filters.getDimSize(3);
+  if (biases.size() != numFilters)
+    throw std::invalid_argument("fastConvolution: expected " +
+                                std::to_string(numFilters) + " biases");
+  DimInt outX = (x + padding.up + padding.down - fx) / strideX + 1;
+  DimInt outY = (y + padding.left + padding.right - fy) / strideY + 1;
+  DoubleTensor res({outX, outY, numFilters, batch});
+  const double* in = data(input);
+  const double* filt = data(filters);
+  const double* bias = data(biases);
+  double* out = data(res);
+
+  // Each (filter, batch item) output plane is independent. Within a plane,
+  // each filter weight is applied to whole output columns at once; the inner
+  // loop runs over contiguous X positions (strided by strideX on the input).
+  parallelFor(0, numFilters * batch, [&](DimInt fb) {
+    DimInt f = fb % numFilters;
+    DimInt b = fb / numFilters;
+    double* outPlane = out + (f + numFilters * b) * outX * outY;
+    std::fill(outPlane, outPlane + outX * outY, bias[f]);
+    for (DimInt ch = 0; ch < c; ++ch) {
+      const double* inPlane = in + (ch + c * b) * x * y;
+      for (DimInt j = 0; j < fy; ++j) {
+        for (DimInt i = 0; i < fx; ++i) {
+          double w = filt[i + fx * (j + fy * (ch + c * f))];
+          // The range of output X positions whose input X is in bounds.
+          DimInt oxBegin = 0;
+          while (oxBegin < outX && oxBegin * strideX + i < padding.up)
+            ++oxBegin;
+          DimInt oxEnd = outX;
+          while (oxEnd > oxBegin &&
+                 (oxEnd - 1) * strideX + i - padding.up >= x)
+            --oxEnd;
+          for (DimInt oy = 0; oy < outY; ++oy) {
+            DimInt iy = oy * strideY + j - padding.left;
+            if (iy < 0 || iy >= y)
+              continue;
+            DimInt inBase = iy * x + i - padding.up;
+            double* outCol = outPlane + oy * outX;
+            for (DimInt ox = oxBegin; ox < oxEnd; ++ox)
+              outCol[ox] += w * inPlane[inBase + ox * strideX];
+          }
+        }
+      }
+    }
+  });
+  return res;
+}
+
+} // namespace helayers
+
+#endif /* TUTORIALS_PLAIN_KERNELS_H */
@@ -0,0 +1,53 @@
+//
+//  ReductionUtils.h
+//  HELayers-Tutorials
+//
+
+#ifndef TUTORIALS_REDUCTION_UTILS_H
+#define TUTORIALS_REDUCTION_UTILS_H
+
+#include <vector>
+
+#include "helayers/math/TTShape.h"
+
+namespace helayers {
+
+/// @brief Returns ceil(log2 n), for n >= 1: the number of rounds in which a
+/// tree halving the values each round reduces n values to one.
+inline int ceilLog2(int n)
+{
+  int res = 0;
+  while ((1 << res) < n)
+    ++res;
+  return res;
+}
+
+/// @brief Returns the tiles of a tile tensor grouped by their position along
+/// "dim": res[g] lists the flat indices of the tiles that are reduced
+/// together, in order along dim. Groups are ordered by the flat index of
+/// their first tile, which is also the flat index order of the reduced
+/// tensor.
+inline std::vector<std::vector<int>> getReductionGroups(const TTShape& shape,
+                                                        int dim)
+{
+  std::vector<DimInt> ext = shape.getExternalSizes();
+  int stride = 1;
+  for (int d = 0; d < dim; ++d)
+    stride *= ext[d];
+  int numTiles = 1;
+  for (DimInt e : ext)
+    numTiles *= e;
+  std::vector<std::vector<int>> res;
+  for (int t = 0; t < numTiles; ++t) {
+    if ((t / stride) % ext[dim] != 0)
+      continue;
+    res.emplace_back();
+    for (int j = 0; j < (int)ext[dim]; ++j)
+      res.back().push_back(t + j * stride);
+  }
+  return res;
+}
+
+} // namespace helayers
+
+#endif /* TUTORIALS_REDUCTION_UTILS_H */
@@ -0,0 +1,275 @@
+//
+//  SignTuner.h
+//  HELayers-Tutorials
+//
+
+#ifndef TUTORIALS_SIGN_TUNER_H
+#define TUTORIALS_SIGN_TUNER_H
+
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "helayers/math/FunctionEvaluator.h"
+
+namespace helayers {
+
+/// @brief A composite polynomial approximation of sign, chosen by
+/// SignTuner::tune().
+struct SignPlan
+{
+  /// The degrees of f and g.
+  int fDegree = 0, gDegree = 0;
+
+  /// The number of repetitions of f and g. g is applied first.
+  int fRep = 0, gRep = 0;
+
+  /// The maximal input absolute value. Inputs are divided by it first.
+  double maxAbsVal = 1;
+
+  /// Whether the result is in [0, 1] rather than [-1, 1].
+  bool binaryRes = false;
+
+  /// The multiplication depth of the evaluation.
+  int depth = 0;
+
+  /// The estimated number of ciphertext-ciphertext multiplications.
+  int estimatedMultiplications = 0;
+
+  /// The maximal output error for inputs at least minGap away from 0.
+  double maxError = 0;
+
+  /// The polynomials to compose, in order, as power basis coefficients.
+  std::vector<std::vector<double>> polys;
+
+  void debugPrint(const std::string& title = "",
+                  std::ostream& out = std::cout) const
+  {
+    out << title << ": g" << gDegree << " x " << gRep << ", f" << fDegree
+        << " x " << fRep << ", depth " << depth << ", ~"
+        << estimatedMultiplications << " multiplications, max error "
+        << maxError << std::endl;
+  }
+};
+
+/// @brief Chooses and evaluates composite polynomial approximations of sign
+/// by the required precision.
+///
+/// FunctionEvaluator::sign() and the functions built on it take gRep and
+/// fRep, which callers tend to over-provision. tune() takes the output
+/// precision and the minimal input gap instead: the smallest |x| that must be
+/// resolved. It searches the compositions g^gRep, then f^fRep, of the
+/// minimax-like odd polynomials f_n and g_n of Cheon et al. (degrees 3, 5 and
+/// 7), simulating each on the plain inputs in [minGap, maxAbsVal], and
+/// returns the one of lowest depth, and then fewest multiplications, that
+/// meets the precision. The plan's depth and cost are known before anything
+/// is evaluated.
+///
+/// The final affine map to [0, 1] for binary results is folded into the last
+/// polynomial, so it costs no level.
+class SignTuner
+{
+  const HeContext& he;
+
+  // f_n(x) = sum_{i=0}^{n} 4^-i C(2i, i) x (1 - x^2)^i, which flattens values
+  // near +-1 towards +-1.
+  static const std::vector<double>& getF(int degree)
+  {
+    static const std::vector<double> f3 = {0, 3.0 / 2, 0, -1.0 / 2};
+    static const std::vector<double> f5 = {
+        0, 15.0 / 8, 0, -10.0 / 8, 0, 3.0 / 8};
+    static const std::vector<double> f7 = {
+        0, 35.0 / 16, 0, -35.0 / 16, 0, 21.0 / 16, 0, -5.0 / 16};
+    return degree == 3 ? f3 : degree == 5 ? f5 : f7;
+  }
+
+  // g_n, which quickly amplifies values near 0 away from it.
+  static const std::vector<double>& getG(int degree)
+  {
+    static const std::vector<double> g3 = {
+        0, 2126.0 / 1024, 0, -1359.0 / 1024};
+    static const std::vector<double> g5 = {
+        0, 3334.0 / 1024, 0, -6108.0 / 1024, 0, 3796.0 / 1024};
+    static const std::vector<double> g7 = {0,
+                                           4589.0 / 1024,
+                                           0,
+                                           -16577.0 / 1024,
+                                           0,
+                                           25614.0 / 1024,
+                                           0,
+                                           -12860.0 / 1024};
+    return degree == 3 ? g3 : degree == 5 ? g5 : g7;
+  }
+
+  static double evalPoly(const std::vector<double>& coefs, double x)
+  {
+    double res = 0;
+    for (int i = (int)coefs.size() - 1; i >= 0; --i)
+      res = res * x + coefs[i];
+    return res;
+  }
+
+  // Multiplications for an odd polynomial of the given degree: the odd
+  // powers from x, x^2 and x^4.
+  static int getNumMultiplications(int degree)
+  {
+    return degree == 3 ? 2 : degree == 5 ? 4 : 5;
+  }
+
+public:
+  /// @brief A constructor.
+  /// @param he The HeContext.
+  SignTuner(const HeContext& he) : he(he) {}
+
+  /// @brief Returns the cheapest composite sign approximation meeting the
+  /// given precision.
+  /// @param precision The maximal output error for inputs x with
+  ///                  minGap <= |x| <= maxAbsVal. With binaryRes, the error
+  ///                  of the [0, 1] result.
+  /// @param minGap    The smallest absolute input value to resolve.
+  /// @param maxAbsVal An upper bound on the absolute input value.
+  /// @param binaryRes If true the result is close to 0 for negative inputs
+  ///                  and to 1 for positive ones, otherwise to -1 and 1.
+  /// @param maxDepth  The maximal allowed depth.
+  /// @throw runtime_error If no composition within maxDepth meets the
+  ///                      precision.
+  static SignPlan tune(double precision,
+                       double minGap,
+                       double maxAbsVal = 1,
+                       bool binaryRes = false,
+                       int maxDepth = 100)
+  {
+    always_assert(minGap > 0 && minGap <= maxAbsVal);
+    // The [0, 1] result has half the error of the [-1, 1] one.
+    double signPrecision = binaryRes ? 2 * precision : precision;
+    int scaleDepth = maxAbsVal == 1 ? 0 : 1;
+
+    // sign is odd, and so are f and g, so positive inputs suffice. Sample
+    // geometrically near minGap and linearly up to 1.
+    double delta = minGap / maxAbsVal;
+    std::vector<double> grid;
+    const int numPoints = 1000;
+    for (int i = 0; i < numPoints; ++i) {
+      grid.push_back(delta * std::pow(1 / delta, (double)i / (numPoints - 1)));
+      grid.push_back(delta + (1 - delta) * i / (numPoints - 1));
+    }
+
+    const int maxRep = 30;
+    SignPlan best;
+    best.depth = -1;
+    for (int gDegree : {3, 5, 7}) {
+      int gDepth = FunctionEvaluator::getPolyEvalMulDepth(getG(gDegree),
+                                                          DEFAULT);
+      for (int fDegree : {3, 5, 7}) {
+        int fDepth = FunctionEvaluator::getPolyEvalMulDepth(getF(fDegree),
+                                                            DEFAULT);
+        std::vector<double> afterG(grid);
+        for (int gRep = 0; gRep <= maxRep; ++gRep) {
+          if (gRep > 0)
+            for (double& v : afterG)
+              v = evalPoly(getG(gDegree), v);
+          std::vector<double> vals(afterG);
+          for (int fRep = 1; fRep <= maxRep; ++fRep) {
+            int depth = scaleDepth + gRep * gDepth + fRep * fDepth;
+            if (depth > maxDepth)
+              break;
+            double error = 0;
+            for (double& v : vals) {
+              v = evalPoly(getF(fDegree), v);
+              error = std::max(error, std::fabs(1 - v));
+            }
+            if (error > signPrecision)
+              continue;
+            int mults = gRep * getNumMultiplications(gDegree) +
+                        fRep * getNumMultiplications(fDegree);
+            if (best.depth < 0 || depth < best.depth ||
+                (depth == best.depth &&
+                 mults < best.estimatedMultiplications)) {
+              best.fDegree = fDegree;
+              best.gDegree = gDegree;
+              best.fRep = fRep;
+              best.gRep = gRep;
+              best.depth = depth;
+              best.estimatedMultiplications = mults;
+              best.maxError = binaryRes ? error / 2 : error;
+            }
+            break;
+          }
+        }
+      }
+    }
+    if (best.depth < 0)
+      throw std::runtime_error(
+          "SignTuner: no composition meets the precision within the depth");
+
+    best.maxAbsVal = maxAbsVal;
+    best.binaryRes = binaryRes;
+    for (int i = 0; i < best.gRep; ++i)
+      best.polys.push_back(getG(best.gDegree));
+    for (int i = 0; i < best.fRep; ++i)
+      best.polys.push_back(getF(best.fDegree));
+    if (binaryRes) {
+      // (p + 1) / 2
+      for (double& c : best.polys.back())
+        c /= 2;
+      best.polys.back()[0] += 0.5;
+    }
+    return best;
+  }
+
+  /// @brief Returns the approximated sign of a, by the given plan.
+  CTile sign(const CTile& a, const SignPlan& plan) const
+  {
+    CTile res(a);
+    if (plan.maxAbsVal != 1)
+      res.multiplyScalar(1 / plan.maxAbsVal);
+    FunctionEvaluator fe(he);
+    fe.polyCompEvalInPlace(res, plan.polys);
+    return res;
+  }
+
+  /// @brief Returns (approximately) 1 where a > b and 0 where a < b. The plan
+  /// must be tuned with binaryRes, for bounds on |a - b|.
+  CTile compare(const CTile& a, const CTile& b, const SignPlan& plan) const
+  {
+    always_assert(plan.binaryRes);
+    CTile diff(a);
+    diff.sub(b);
+    return sign(diff, plan);
+  }
+
+  /// @brief Returns |a|. The plan must not be tuned with binaryRes. This costs
+  /// one more level than the plan.
+  CTile abs(const CTile& a, const SignPlan& plan) const
+  {
+    always_assert(!plan.binaryRes);
+    CTile res = sign(a, plan);
+    CTile src(a);
+    if (src.getChainIndex() > res.getChainIndex())
+      src.setChainIndex(res.getChainIndex());
+    res.multiply(src);
+    return res;
+  }
+
+  /// @brief Returns min(a, b) = (a + b - |a - b|) / 2. The plan must not be
+  /// tuned with binaryRes, and is for bounds on |a - b|. This costs two more
+  /// levels than the plan.
+  CTile min(const CTile& a, const CTile& b, const SignPlan& plan) const
+  {
+    CTile diff(a);
+    diff.sub(b);
+    CTile res(a);
+    res.add(b);
+    CTile absDiff = abs(diff, plan);
+    res.setChainIndex(absDiff.getChainIndex());
+    res.sub(absDiff);
+    res.multiplyScalar(0.5);
+    return res;
+  }
+};
+
+} // namespace helayers
+
+#endif /* TUTORIALS_SIGN_TUNER_H */
@@ -0,0 +1,75 @@
+//
+//  SlotMaps.h
+//  HELayers-Tutorials
+//
+
+#ifndef TUTORIALS_SLOT_MAPS_H
+#define TUTORIALS_SLOT_MAPS_H
+
+#include <vector>
+
+#include "helayers/math/TTShape.h"
+
+namespace helayers {
+
+/// @brief Returns, for every slot of every tile of a tensor packed with
+/// "shape", the flat index of the tensor element it holds, or -1 if it holds
+/// no element. res[t][s] refers to slot s of the tile with flat index t.
+/// Element indices follow the first order (first dim runs fastest) layout of
+/// DoubleTensor.
+///
+/// The map follows the tile tensor layout: tiles, and slots inside a tile,
+/// are both in first order. Along a dim with tile size n and external size
+/// m, slot j of external index k holds element k * n + j, or j * m + k if
+/// the dim is interleaved, and along a duplicated dim the first
+/// getNumDuplicated() slots all hold element 0.
+/// @param he    The HeContext.
+/// @param shape The tile tensor shape. Its original sizes must be set.
+inline std::vector<std::vector<int64_t>> getSlotElementMap(
+    const HeContext& he,
+    const TTShape& shape)
+{
+  always_assert(shape.getNumSlotsInTile() == he.slotCount());
+  DimInt numDims = shape.getNumDims();
+  std::vector<DimInt> ext = shape.getExternalSizes();
+  std::vector<DimInt> origSizes = shape.getOriginalSizes();
+  int64_t numTiles = 1;
+  for (DimInt e : ext)
+    numTiles *= e;
+
+  std::vector<std::vector<int64_t>> res(
+      numTiles, std::vector<int64_t>(he.slotCount(), -1));
+  std::vector<DimInt> tileInd(numDims, 0);
+  for (int64_t t = 0; t < numTiles; ++t) {
+    for (int s = 0; s < he.slotCount(); ++s) {
+      int64_t flat = 0, elementStride = 1;
+      int rest = s;
+      bool used = true;
+      for (DimInt d = 0; d < numDims && used; ++d) {
+        const TTDim& dim = shape.getDim(d);
+        DimInt j = rest % dim.getTileSize();
+        rest /= dim.getTileSize();
+        int64_t i;
+        if (dim.getNumDuplicated() > 1)
+          i = j < dim.getNumDuplicated() && tileInd[d] == 0 ? 0 : -1;
+        else if (dim.isInterleaved())
+          i = (int64_t)j * ext[d] + tileInd[d];
+        else
+          i = (int64_t)tileInd[d] * dim.getTileSize() + j;
+        used = i >= 0 && i < origSizes[d];
+        flat += i * elementStride;
+        elementStride *= origSizes[d];
+      }
+      if (used)
+        res[t][s] = flat;
+    }
+    // Advance to the next tile, in first order.
+    for (DimInt d = 0; d < numDims && ++tileInd[d] == ext[d]; ++d)
+      tileInd[d] = 0;
+  }
+  return res;
+}
+
+} // namespace helayers
+
+#endif /* TUTORIALS_SLOT_MAPS_H */
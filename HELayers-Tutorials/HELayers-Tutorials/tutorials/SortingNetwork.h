@@ -0,0 +1,268 @@
+//
+//  SortingNetwork.h
+//  HELayers-Tutorials
+//
+
+#ifndef TUTORIALS_SORTING_NETWORK_H
+#define TUTORIALS_SORTING_NETWORK_H
+
+#include <functional>
+#include <vector>
+
+#include "helayers/hebase/Encoder.h"
+#include "helayers/math/CTileTensor.h"
+#include "ParallelFor.h"
+#include "ReductionUtils.h"
+#include "SignTuner.h"
+
+namespace helayers {
+
+/// @brief Sorts encrypted values in slots with a bitonic sorting network.
+///
+/// Each stage of the network compares every position p with p + j, for the
+/// positions whose bit j is clear, and puts the min or the max of the pair in
+/// p, as the direction of its block requires, and the other in p + j. All the
+/// comparators of a stage are computed at once: with d = x - rot(x, j) and
+/// c = cmp(x, rot(x, j)),
+///
+///   L = c * (s d) - (t d),   x' = x + L - rot(L, -j),
+///
+/// where s is -1 at ascending lower positions, +1 at descending ones and 0
+/// elsewhere, and t is 1 at descending lower positions. The plaintext masks
+/// are applied to d while c is computed, so a stage takes one level more than
+/// a comparison. n values take log2(n) (log2(n) + 1) / 2 stages.
+///
+/// topK() sorts blocks of k values, then repeatedly keeps the max of pairs of
+/// blocks and re-sorts them, which takes far fewer stages than a full sort
+/// for small k.
+///
+/// The values must be in [minValue, maxValue]. Pairs closer than minGap may
+/// come out in either order, and their values may be mixed.
+class SortingNetwork
+{
+  // Which positions of the slots are sorted, and how.
+  struct Layout
+  {
+    // Moving one position moves this many slots.
+    int stride;
+
+    // The number of positions, a power of 2.
+    int size;
+
+    // Slots from this one on are not sorted.
+    int numSlots;
+
+    int getPosition(int slot) const
+    {
+      return slot < numSlots ? (slot / stride) % size : -1;
+    }
+  };
+
+  // The direction of the comparator at a lower position: 1 to put the min
+  // there, -1 the max, 0 to leave it.
+  using Direction = std::function<int(int)>;
+
+  const HeContext& he;
+  SignTuner tuner;
+  double minValue, maxValue;
+  SignPlan plan;
+
+  void stage(CTile& x,
+             const Layout& layout,
+             int j,
+             const Direction& dir,
+             bool updateUpper) const
+  {
+    CTile other(x);
+    other.rotate(j * layout.stride);
+    CTile d(x);
+    d.sub(other);
+    CTile c = tuner.compare(x, other, plan);
+
+    std::vector<double> s(he.slotCount(), 0), t(he.slotCount(), 0);
+    for (int slot = 0; slot < he.slotCount(); ++slot) {
+      int p = layout.getPosition(slot);
+      if (p < 0 || (p & j) != 0)
+        continue;
+      int dr = dir(p);
+      s[slot] = -dr;
+      t[slot] = dr < 0 ? 1 : 0;
+    }
+    Encoder enc(he);
+    PTile sP(he), tP(he);
+    enc.encode(sP, s, d.getChainIndex());
+    enc.encode(tP, t, d.getChainIndex());
+    CTile td(d);
+    td.multiplyPlain(tP);
+    d.multiplyPlain(sP);
+    d.setChainIndex(c.getChainIndex());
+    d.multiply(c);
+    td.setChainIndex(d.getChainIndex());
+    d.sub(td);
+    if (updateUpper) {
+      CTile upper(d);
+      upper.rotate(-j * layout.stride);
+      d.sub(upper);
+    }
+    x.setChainIndex(d.getChainIndex());
+    x.add(d);
+  }
+
+  // Sorts blocks of blockSize positions, ascending where bit blockSize of
+  // the position is clear and descending where it is set, or the other way
+  // around if flip.
+  void sortBlocks(CTile& x, const Layout& layout, int blockSize, bool flip)
+      const
+  {
+    for (int k = 2; k <= blockSize; k *= 2)
+      for (int j = k / 2; j >= 1; j /= 2)
+        stage(x, layout, j, [k, flip](int p) {
+          return ((p & k) == 0) != flip ? 1 : -1;
+        }, true);
+  }
+
+  // Adds val to the sorted slots. Shifting the values to be nonnegative puts
+  // the zeros in the other slots below all of them.
+  void shift(CTile& x, const Layout& layout, double val) const
+  {
+    std::vector<double> vals(he.slotCount(), 0);
+    for (int slot = 0; slot < he.slotCount(); ++slot)
+      if (layout.getPosition(slot) >= 0)
+        vals[slot] = val;
+    Encoder enc(he);
+    PTile p(he);
+    enc.encode(p, vals, x.getChainIndex());
+    x.addPlain(p);
+  }
+
+public:
+  /// @brief A constructor.
+  /// @param he        The HeContext.
+  /// @param minValue  A lower bound on the values.
+  /// @param maxValue  An upper bound on the values.
+  /// @param minGap    The minimal gap between values that must be ordered.
+  /// @param precision The precision of each comparison, in [0, 1].
+  SortingNetwork(const HeContext& he,
+                 double minValue,
+                 double maxValue,
+                 double minGap,
+                 double precision = 1e-2)
+      : he(he),
+        tuner(he),
+        minValue(minValue),
+        maxValue(maxValue),
+        plan(SignTuner::tune(precision, minGap, maxValue - minValue, true))
+  {}
+
+  /// @brief Returns the number of stages of sort() over n values.
+  static int getNumSortStages(int n)
+  {
+    return ceilLog2(n) * (ceilLog2(n) + 1) / 2;
+  }
+
+  /// @brief Returns the number of stages of topK() over n values.
+  static int getNumTopKStages(int n, int k)
+  {
+    return getNumSortStages(k) +
+           (ceilLog2(n) - ceilLog2(k)) * (1 + ceilLog2(k));
+  }
+
+  /// @brief Returns the multiplication depth of the given number of stages.
+  int getDepth(int numStages) const { return numStages * (plan.depth + 1); }
+
+  /// @brief Returns src with its first n slots sorted.
+  /// @param src        The values. Slots n and above must be zero.
+  /// @param n          The number of values, a power of 2.
+  /// @param descending If true, sorts in descending order.
+  CTile sort(const CTile& src, int n, bool descending = false) const
+  {
+    always_assert((n & (n - 1)) == 0 && n <= he.slotCount());
+    Layout layout{1, n, n};
+    CTile res(src);
+    shift(res, layout, -minValue);
+    sortBlocks(res, layout, n, descending);
+    shift(res, layout, minValue);
+    return res;
+  }
+
+  /// @brief Returns the k largest of the first n slots of src in slots 0 to
+  /// k-1, in descending order. The other slots are unknown.
+  /// @param src The values. Slots n and above must be zero.
+  /// @param n   The number of values, a power of 2.
+  /// @param k   The number of values to keep, a power of 2 up to n.
+  CTile topK(const CTile& src, int n, int k) const
+  {
+    always_assert((n & (n - 1)) == 0 && n <= he.slotCount());
+    always_assert((k & (k - 1)) == 0 && k <= n);
+    Layout layout{1, n, n};
+    CTile res(src);
+    shift(res, layout, -minValue);
+    // The last sort of the blocks is the descending one.
+    bool flip = k == n;
+    sortBlocks(res, layout, k, flip);
+    for (int w = k; w < n; w *= 2) {
+      // Keep the max of each pair of blocks w apart in the lower block. They
+      // are sorted in opposite directions, so the result is bitonic.
+      stage(res, layout, w, [w, k](int p) {
+        return p % (2 * w) < k ? -1 : 0;
+      }, false);
+      // Sort the kept blocks, in alternating directions.
+      bool last = 2 * w >= n;
+      for (int j = k / 2; j >= 1; j /= 2)
+        stage(res, layout, j, [w, k, last](int p) {
+          if (p % (2 * w) >= k)
+            return 0;
+          return ((p & (2 * w)) == 0) != last ? 1 : -1;
+        }, true);
+    }
+    // The lowest slots are the only ones shifted back.
+    shift(res, Layout{1, k, k}, minValue);
+    return res;
+  }
+
+  /// @brief Returns c sorted along dim. The tiles are sorted independently,
+  /// in parallel. dim must be in a single tile, i.e., have external size 1,
+  /// with a tile size that is a power of 2, and its unused slots must hold
+  /// zeros. Unused slots of the result are unknown.
+  /// @param c          The tensor.
+  /// @param dim        The dimension to sort along.
+  /// @param descending If true, sorts in descending order, else in ascending
+  ///                   order.
+  CTileTensor sortOverDim(const CTileTensor& c, int dim, bool descending)
+      const
+  {
+    const TTShape& shape = c.getShape();
+    always_assert(shape.getDim(dim).getExternalSize() == 1);
+    always_assert(!shape.getDim(dim).getAreUnusedSlotsUnknown());
+    int tileSize = shape.getDim(dim).getTileSize();
+    always_assert((tileSize & (tileSize - 1)) == 0);
+    int stride = 1;
+    for (int d = 0; d < dim; ++d)
+      stride *= shape.getDim(d).getTileSize();
+    Layout layout{stride, tileSize, he.slotCount()};
+
+    // Map only the used slots to be nonnegative, so that the zeros of the
+    // unused ones are below all the values, and sort in descending order,
+    // which moves the zeros to the unused positions at the end. An ascending
+    // sort is the descending sort of maxValue - c, mapped back.
+    CTileTensor shifted(c);
+    if (!descending)
+      shifted.negate();
+    shifted.addScalar(descending ? -minValue : maxValue, true);
+    std::vector<CTile> tiles(c.getNumUsedTiles(), CTile(he));
+    parallelFor(0, c.getNumUsedTiles(), [&](int t) {
+      tiles[t] = shifted.getTileByFlatIndex(t);
+      sortBlocks(tiles[t], layout, tileSize, true);
+      if (!descending)
+        tiles[t].negate();
+      tiles[t].addScalar(descending ? minValue : maxValue);
+    });
+    TTShape resShape(shape);
+    resShape.setAllUnusedSlotsUnknown();
+    return CTileTensor::createFromCTileVector(he, resShape, tiles);
+  }
+};
+
+} // namespace helayers
+
+#endif /* TUTORIALS_SORTING_NETWORK_H */
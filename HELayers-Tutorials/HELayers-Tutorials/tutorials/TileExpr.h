@@ -0,0 +1,323 @@
+//
+//  TileExpr.h
+//  HELayers-Tutorials
+//
+
+#ifndef TUTORIALS_TILE_EXPR_H
+#define TUTORIALS_TILE_EXPR_H
+
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "helayers/math/CTileTensor.h"
+#include "helayers/math/PTileTensor.h"
+#include "ParallelFor.h"
+
+namespace helayers {
+
+/// Expression templates for element-wise tile tensor arithmetic.
+///
+/// Wrap operands with lazy() and combine them with +, - and *, e.g.,
+/// evaluate(lazy(a) * lazy(b) + lazy(c) * lazy(w)). This builds an
+/// expression tree at compile time, without computing anything.
+/// evaluate() then computes the result in a single pass over the tiles, in
+/// parallel, with no intermediate tensors. Products are kept
+/// raw, and sums of products at the same level are added raw, so each output
+/// tile is relinearized and rescaled once.
+///
+/// All operands must have the same shape. Operands at different chain
+/// indices are lowered to the lower one, as CTileTensor operators do, and
+/// plaintext operands are re-encoded at the chain index of the ciphertext
+/// they meet.
+namespace expr {
+
+/// @brief A tile being computed, with its pending relinearization and
+/// rescale.
+struct EvalTile
+{
+  CTile tile;
+  bool needsRelinearize = false;
+  bool needsRescale = false;
+
+  /// @brief Performs the pending relinearization and rescale.
+  void settle()
+  {
+    if (needsRelinearize)
+      tile.relinearize();
+    if (needsRescale)
+      tile.rescale();
+    needsRelinearize = false;
+    needsRescale = false;
+  }
+};
+
+/// @brief Lowers the higher of two settled tiles to the chain index of the
+/// other.
+inline void alignChainIndices(CTile& a, CTile& b)
+{
+  if (a.getChainIndex() > b.getChainIndex())
+    a.setChainIndex(b.getChainIndex());
+  else if (b.getChainIndex() > a.getChainIndex())
+    b.setChainIndex(a.getChainIndex());
+}
+
+/// @brief Returns "plain" at the chain index of the settled "tile",
+/// re-encoding it into "scratch" if needed.
+inline const PTile& alignPlain(const PTile& plain, CTile& tile, PTile& scratch)
+{
+  if (plain.getChainIndex() == tile.getChainIndex())
+    return plain;
+  plain.reencode(scratch, tile.getChainIndex());
+  return scratch;
+}
+
+/// @brief Base class of all expression nodes, for type checking.
+struct ExprBase
+{};
+
+template <class T>
+constexpr bool isExpr = std::is_base_of<ExprBase, T>::value;
+
+/// @brief Returns a pointer to "src" that doesn't own it.
+template <class T>
+std::shared_ptr<const T> borrow(const T& src)
+{
+  return std::shared_ptr<const T>(&src, [](const T*) {});
+}
+
+/// @brief A ciphertext leaf. Refers to its operand, or owns it if it was
+/// given as an rvalue.
+struct CLeaf : ExprBase
+{
+  static constexpr bool isPlain = false;
+  std::shared_ptr<const CTileTensor> src;
+
+  explicit CLeaf(std::shared_ptr<const CTileTensor> src) : src(std::move(src))
+  {}
+
+  EvalTile evalTile(int t) const
+  {
+    return EvalTile{src->getTileByFlatIndex(t)};
+  }
+  const CTileTensor* getAnyCipher() const { return src.get(); }
+  void assertShapes(const TTShape& shape) const
+  {
+    shape.assertCompatible(src->getShape(), "expression operand");
+    always_assert(src->getShape().getExternalSizes() ==
+                  shape.getExternalSizes());
+  }
+};
+
+/// @brief A plaintext leaf. May only be a direct operand of an operation
+/// with a ciphertext expression. Refers to its operand, or owns it if it was
+/// given as an rvalue.
+struct PLeaf : ExprBase
+{
+  static constexpr bool isPlain = true;
+  std::shared_ptr<const PTileTensor> src;
+
+  explicit PLeaf(std::shared_ptr<const PTileTensor> src) : src(std::move(src))
+  {}
+
+  const PTile& getTile(int t) const { return src->getTileByFlatIndex(t); }
+  const CTileTensor* getAnyCipher() const { return nullptr; }
+  void assertShapes(const TTShape& shape) const
+  {
+    shape.assertCompatible(src->getShape(), "expression operand");
+    always_assert(src->getShape().getExternalSizes() ==
+                  shape.getExternalSizes());
+  }
+};
+
+/// @brief A sum or difference of two expressions.
+template <class L, class R, bool subtract>
+struct AddNode : ExprBase
+{
+  static_assert(!(L::isPlain && R::isPlain),
+                "At least one operand must be a ciphertext");
+  static constexpr bool isPlain = false;
+  L l;
+  R r;
+
+  AddNode(const L& l, const R& r) : l(l), r(r) {}
+
+  EvalTile evalTile(int t) const
+  {
+    if constexpr (R::isPlain) {
+      EvalTile res = l.evalTile(t);
+      res.settle();
+      PTile scratch(res.tile.getHeContext());
+      const PTile& p = alignPlain(r.getTile(t), res.tile, scratch);
+      if (subtract)
+        res.tile.subPlain(p);
+      else
+        res.tile.addPlain(p);
+      return res;
+    } else if constexpr (L::isPlain) {
+      EvalTile res = r.evalTile(t);
+      res.settle();
+      if (subtract)
+        res.tile.negate();
+      PTile scratch(res.tile.getHeContext());
+      res.tile.addPlain(alignPlain(l.getTile(t), res.tile, scratch));
+      return res;
+    } else {
+      EvalTile a = l.evalTile(t);
+      EvalTile b = r.evalTile(t);
+      if (a.needsRescale == b.needsRescale &&
+          a.tile.getChainIndex() == b.tile.getChainIndex()) {
+        // Same level and scale: add raw and keep what's pending.
+        if (subtract)
+          a.tile.subRaw(b.tile);
+        else
+          a.tile.addRaw(b.tile);
+        a.needsRelinearize = a.needsRelinearize || b.needsRelinearize;
+        return a;
+      }
+      a.settle();
+      b.settle();
+      alignChainIndices(a.tile, b.tile);
+      if (subtract)
+        a.tile.sub(b.tile);
+      else
+        a.tile.add(b.tile);
+      return a;
+    }
+  }
+
+  const CTileTensor* getAnyCipher() const
+  {
+    const CTileTensor* res = l.getAnyCipher();
+    return res ? res : r.getAnyCipher();
+  }
+  void assertShapes(const TTShape& shape) const
+  {
+    l.assertShapes(shape);
+    r.assertShapes(shape);
+  }
+};
+
+/// @brief A product of two expressions.
+template <class L, class R>
+struct MulNode : ExprBase
+{
+  static_assert(!(L::isPlain && R::isPlain),
+                "At least one operand must be a ciphertext");
+  static constexpr bool isPlain = false;
+  L l;
+  R r;
+
+  MulNode(const L& l, const R& r) : l(l), r(r) {}
+
+  EvalTile evalTile(int t) const
+  {
+    if constexpr (R::isPlain) {
+      EvalTile res = l.evalTile(t);
+      res.settle();
+      PTile scratch(res.tile.getHeContext());
+      res.tile.multiplyPlainRaw(alignPlain(r.getTile(t), res.tile, scratch));
+      res.needsRescale = true;
+      return res;
+    } else if constexpr (L::isPlain) {
+      EvalTile res = r.evalTile(t);
+      res.settle();
+      PTile scratch(res.tile.getHeContext());
+      res.tile.multiplyPlainRaw(alignPlain(l.getTile(t), res.tile, scratch));
+      res.needsRescale = true;
+      return res;
+    } else {
+      EvalTile a = l.evalTile(t);
+      EvalTile b = r.evalTile(t);
+      a.settle();
+      b.settle();
+      alignChainIndices(a.tile, b.tile);
+      a.tile.multiplyRaw(b.tile);
+      a.needsRelinearize = true;
+      a.needsRescale = true;
+      return a;
+    }
+  }
+
+  const CTileTensor* getAnyCipher() const
+  {
+    const CTileTensor* res = l.getAnyCipher();
+    return res ? res : r.getAnyCipher();
+  }
+  void assertShapes(const TTShape& shape) const
+  {
+    l.assertShapes(shape);
+    r.assertShapes(shape);
+  }
+};
+
+/// @brief Starts an expression with a ciphertext operand. The expression
+/// refers to "src", which must outlive it.
+inline CLeaf lazy(const CTileTensor& src) { return CLeaf(borrow(src)); }
+
+/// @brief Starts an expression with a temporary ciphertext operand, e.g.,
+/// lazy(a.getAdd(b)). The expression takes ownership of it.
+inline CLeaf lazy(CTileTensor&& src)
+{
+  return CLeaf(std::make_shared<const CTileTensor>(std::move(src)));
+}
+
+/// @brief Starts an expression with a plaintext operand. The expression
+/// refers to "src", which must outlive it.
+inline PLeaf lazy(const PTileTensor& src) { return PLeaf(borrow(src)); }
+
+/// @brief Starts an expression with a temporary plaintext operand. The
+/// expression takes ownership of it.
+inline PLeaf lazy(PTileTensor&& src)
+{
+  return PLeaf(std::make_shared<const PTileTensor>(std::move(src)));
+}
+
+template <class L,
+          class R,
+          class = std::enable_if_t<isExpr<L> && isExpr<R>>>
+AddNode<L, R, false> operator+(const L& l, const R& r)
+{
+  return AddNode<L, R, false>(l, r);
+}
+
+template <class L,
+          class R,
+          class = std::enable_if_t<isExpr<L> && isExpr<R>>>
+AddNode<L, R, true> operator-(const L& l, const R& r)
+{
+  return AddNode<L, R, true>(l, r);
+}
+
+template <class L,
+          class R,
+          class = std::enable_if_t<isExpr<L> && isExpr<R>>>
+MulNode<L, R> operator*(const L& l, const R& r)
+{
+  return MulNode<L, R>(l, r);
+}
+
+/// @brief Computes an expression tile by tile and returns the result. Each
+/// output tile is relinearized and rescaled at most once.
+template <class E, class = std::enable_if_t<isExpr<E>>>
+CTileTensor evaluate(const E& e)
+{
+  const CTileTensor* first = e.getAnyCipher();
+  // Tiles are paired by their flat index.
+  e.assertShapes(first->getShape());
+  const HeContext& he = first->getHeContext();
+  int numTiles = first->getNumUsedTiles();
+  std::vector<CTile> tiles(numTiles, CTile(he));
+  parallelFor(0, numTiles, [&](int t) {
+    EvalTile res = e.evalTile(t);
+    res.settle();
+    tiles[t] = std::move(res.tile);
+  });
+  return CTileTensor::createFromCTileVector(he, first->getShape(), tiles);
+}
+
+} // namespace expr
+
+} // namespace helayers
+
+#endif /* TUTORIALS_TILE_EXPR_H */
@@ -0,0 +1,318 @@
+//
+//  TournamentEvaluator.h
+//  HELayers-Tutorials
+//
+
+#ifndef TUTORIALS_TOURNAMENT_EVALUATOR_H
+#define TUTORIALS_TOURNAMENT_EVALUATOR_H
+
+#include <vector>
+
+#include "helayers/hebase/Encoder.h"
+#include "helayers/math/CTileTensor.h"
+#include "ParallelFor.h"
+#include "ReductionUtils.h"
+#include "SignTuner.h"
+
+namespace helayers {
+
+/// @brief Computes max, min and argmax over slots and over tile tensor dims,
+/// as tournaments of log depth.
+///
+/// Each round of a tournament compares every value with the one rot slots
+/// (or one tile) away and keeps the larger, max(a, b) = b + cmp(a, b) (a - b),
+/// so n values take log2(n) rounds, and all the comparisons of a round, in
+/// all slots, are one SIMD comparison. The tile pairs of a round over tiles
+/// are combined in parallel. The min is the max of the negated values. The
+/// argmax is a one-hot indicator, computed by comparing the values with the
+/// broadcast max, lowered by half the minimal gap.
+///
+/// The comparisons are tuned by SignTuner for values in [minValue, maxValue]
+/// whose maximum (or minimum, for the min) is at least minGap away from any
+/// other value.
+class TournamentEvaluator
+{
+  const HeContext& he;
+  SignTuner tuner;
+  double minValue, maxValue, minGap, precision;
+  SignPlan plan;
+
+  // Sets a to max(a, b).
+  void maxInPlace(CTile& a, const CTile& b) const
+  {
+    CTile greater = tuner.compare(a, b, plan);
+    CTile diff(a);
+    diff.sub(b);
+    diff.setChainIndex(greater.getChainIndex());
+    diff.multiply(greater);
+    a = b;
+    a.setChainIndex(diff.getChainIndex());
+    a.add(diff);
+  }
+
+  // The max is off by up to this much, after the given number of rounds.
+  double getMaxError(int rounds) const
+  {
+    return rounds * plan.maxError * (maxValue - minValue);
+  }
+
+  SignPlan getIndicatorPlan(int rounds) const
+  {
+    // The max is compared with max - minGap / 2. Both the max and the other
+    // values are at least gap away from it.
+    double gap = minGap / 2 - getMaxError(rounds);
+    always_assert(gap > 0);
+    return SignTuner::tune(
+        precision, gap, maxValue - minValue + minGap / 2, true);
+  }
+
+  // Returns c with its used slots shifted by -minValue, to be nonnegative,
+  // so the zeros in the unused slots never win. With negated, returns
+  // maxValue - c instead, whose max is maxValue - min(c).
+  CTileTensor getShifted(const CTileTensor& c,
+                         int dim,
+                         bool negated = false) const
+  {
+    always_assert(!c.getShape().getDim(dim).getAreUnusedSlotsUnknown());
+    CTileTensor res(c);
+    if (negated) {
+      res.negate();
+      res.addScalar(maxValue, true);
+    } else {
+      res.addScalar(-minValue, true);
+    }
+    return res;
+  }
+
+  // Returns the tensor of the given maxes, one per group, with original size
+  // 1 along dim.
+  CTileTensor getReducedTensor(const CTileTensor& c,
+                               int dim,
+                               const std::vector<CTile>& maxes) const
+  {
+    TTShape resShape(c.getShape());
+    int tileSize = resShape.getDim(dim).getTileSize();
+    resShape.getDim(dim) = TTDim(1, tileSize, 1, tileSize > 1);
+    return CTileTensor::createFromCTileVector(he, resShape, maxes);
+  }
+
+  // Returns the max over dim of each group of tiles of shifted, from
+  // getShifted(), valid at position 0 along dim. The maxes are shifted too.
+  std::vector<CTile> getGroupMaxes(const CTileTensor& shifted,
+                                   int dim,
+                                   std::vector<std::vector<int>>& groups) const
+  {
+    const TTShape& shape = shifted.getShape();
+    groups = getReductionGroups(shape, dim);
+    std::vector<CTile> tiles(shifted.getNumUsedTiles(), CTile(he));
+    for (int t = 0; t < shifted.getNumUsedTiles(); ++t)
+      tiles[t] = shifted.getTileByFlatIndex(t);
+
+    // Rounds over the tiles of each group, all the pairs of a round in
+    // parallel.
+    size_t groupSize = groups[0].size();
+    for (size_t step = 1; step < groupSize; step *= 2) {
+      std::vector<std::pair<int, int>> pairs;
+      for (const std::vector<int>& g : groups)
+        for (size_t i = 0; i + step < g.size(); i += 2 * step)
+          pairs.emplace_back(g[i], g[i + step]);
+      parallelFor(0, (int)pairs.size(), [&](int p) {
+        maxInPlace(tiles[pairs[p].first], tiles[pairs[p].second]);
+      });
+    }
+
+    // Rounds inside the tiles. In the first order layout, moving one step
+    // along dim moves slotStride slots.
+    int slotStride = 1;
+    for (int d = 0; d < dim; ++d)
+      slotStride *= shape.getDim(d).getTileSize();
+    int tileSize = shape.getDim(dim).getTileSize();
+    std::vector<CTile> res(groups.size(), CTile(he));
+    parallelFor(0, (int)groups.size(), [&](int g) {
+      res[g] = std::move(tiles[groups[g][0]]);
+      for (int rot = 1; rot < tileSize; rot *= 2) {
+        CTile other(res[g]);
+        other.rotate(rot * slotStride);
+        maxInPlace(res[g], other);
+      }
+    });
+    return res;
+  }
+
+public:
+  /// @brief A constructor.
+  /// @param he        The HeContext.
+  /// @param minValue  A lower bound on the values.
+  /// @param maxValue  An upper bound on the values.
+  /// @param minGap    The minimal gap between the maximum (or the minimum)
+  ///                  and any other value.
+  /// @param precision The precision of each comparison, in [0, 1].
+  TournamentEvaluator(const HeContext& he,
+                      double minValue,
+                      double maxValue,
+                      double minGap,
+                      double precision = 1e-2)
+      : he(he),
+        tuner(he),
+        minValue(minValue),
+        maxValue(maxValue),
+        minGap(minGap),
+        precision(precision),
+        plan(SignTuner::tune(precision, minGap, maxValue - minValue, true))
+  {}
+
+  /// @brief Returns the depth of max(), min(), maxOverDim() and minOverDim()
+  /// over n values.
+  int getMaxDepth(int n) const { return ceilLog2(n) * (plan.depth + 1); }
+
+  /// @brief Returns the depth of argmaxOverDim() over n values. argmax()
+  /// takes one level less.
+  int getArgmaxDepth(int n) const
+  {
+    int rounds = ceilLog2(n);
+    // One more level masks the max before it is broadcast.
+    return getMaxDepth(n) + 1 + getIndicatorPlan(rounds).depth;
+  }
+
+  /// @brief Returns the max of the first n slots of src, in all slots.
+  /// @param src The values. Slots n and above must be zero.
+  /// @param n   The number of values, a power of 2 dividing the slot count.
+  CTile max(const CTile& src, int n) const
+  {
+    always_assert((n & (n - 1)) == 0 && he.slotCount() % n == 0);
+    // Repeat the values over all the slots, so that cyclic rotations rotate
+    // each copy in place.
+    CTile res(src);
+    for (int r = n; r < he.slotCount(); r *= 2) {
+      CTile shifted(res);
+      shifted.rotate(-r);
+      res.add(shifted);
+    }
+    for (int rot = 1; rot < n; rot *= 2) {
+      CTile other(res);
+      other.rotate(rot);
+      maxInPlace(res, other);
+    }
+    return res;
+  }
+
+  /// @brief Returns the min of the first n slots of src, in all slots. The
+  /// same requirements as for max() hold.
+  CTile min(const CTile& src, int n) const
+  {
+    // The negated values are in [-maxValue, -minValue], a range as wide as
+    // the one the comparisons are tuned for.
+    CTile negated(src);
+    negated.negate();
+    CTile res = max(negated, n);
+    res.negate();
+    return res;
+  }
+
+  /// @brief Returns a one-hot indicator of the max of the first n slots of
+  /// src: 1 in the slot of the max, 0 in the other slots below n. Slots n
+  /// and above are unknown.
+  CTile argmax(const CTile& src, int n) const
+  {
+    // Compare the values shifted by -minValue, with the zeros of the slots
+    // from n on left as they are, so all the differences are within the
+    // bounds of the indicator plan.
+    CTile threshold = max(src, n);
+    threshold.addScalar(-minGap / 2 - minValue);
+    CTile vals(src);
+    vals.setChainIndex(threshold.getChainIndex());
+    std::vector<double> shift(he.slotCount(), 0);
+    for (int i = 0; i < n; ++i)
+      shift[i] = -minValue;
+    Encoder enc(he);
+    PTile shiftP(he);
+    enc.encode(shiftP, shift, vals.getChainIndex());
+    vals.addPlain(shiftP);
+    return tuner.compare(vals, threshold, getIndicatorPlan(ceilLog2(n)));
+  }
+
+  /// @brief Returns the max of c over dim. The result has original size 1
+  /// along dim, with unknown values in the remaining slots of that dim. The
+  /// tile size along dim must be a power of 2, and the unused slots of dim
+  /// must hold zeros.
+  CTileTensor maxOverDim(const CTileTensor& c, int dim) const
+  {
+    std::vector<std::vector<int>> groups;
+    std::vector<CTile> res = getGroupMaxes(getShifted(c, dim), dim, groups);
+    for (CTile& m : res)
+      m.addScalar(minValue);
+    return getReducedTensor(c, dim, res);
+  }
+
+  /// @brief Returns the min of c over dim, as maxOverDim() returns the max.
+  /// The same requirements hold.
+  CTileTensor minOverDim(const CTileTensor& c, int dim) const
+  {
+    std::vector<std::vector<int>> groups;
+    std::vector<CTile> res =
+        getGroupMaxes(getShifted(c, dim, true), dim, groups);
+    for (CTile& m : res) {
+      m.negate();
+      m.addScalar(maxValue);
+    }
+    return getReducedTensor(c, dim, res);
+  }
+
+  /// @brief Returns a one-hot indicator of the max of c over dim, of the
+  /// shape of c. The unused slots of the result are unknown. The same
+  /// requirements as for maxOverDim() hold.
+  CTileTensor argmaxOverDim(const CTileTensor& c, int dim) const
+  {
+    const TTShape& shape = c.getShape();
+    // The values and the thresholds are compared shifted by -minValue, with
+    // the unused slots left zero, so all the differences are within the
+    // bounds of the indicator plan.
+    CTileTensor shifted = getShifted(c, dim);
+    std::vector<std::vector<int>> groups;
+    std::vector<CTile> maxes = getGroupMaxes(shifted, dim, groups);
+    int slotStride = 1;
+    for (int d = 0; d < dim; ++d)
+      slotStride *= shape.getDim(d).getTileSize();
+    int tileSize = shape.getDim(dim).getTileSize();
+
+    // Broadcast the max from position 0 along dim to all positions, keeping
+    // only position 0 first.
+    std::vector<double> mask(he.slotCount());
+    for (int s = 0; s < he.slotCount(); ++s)
+      mask[s] = (s / slotStride) % tileSize == 0 ? 1 : 0;
+    Encoder enc(he);
+    PTile maskP(he);
+    enc.encode(maskP, mask, maxes[0].getChainIndex());
+    parallelFor(0, (int)maxes.size(), [&](int g) {
+      maxes[g].multiplyPlain(maskP);
+      for (int rot = 1; rot < tileSize; rot *= 2) {
+        CTile moved(maxes[g]);
+        moved.rotate(-rot * slotStride);
+        maxes[g].add(moved);
+      }
+      maxes[g].addScalar(-minGap / 2);
+    });
+
+    std::vector<int> groupOf(c.getNumUsedTiles());
+    for (int g = 0; g < (int)groups.size(); ++g)
+      for (int t : groups[g])
+        groupOf[t] = g;
+    int rounds = ceilLog2(shape.getDim(dim).getExternalSize()) +
+                 ceilLog2(tileSize);
+    SignPlan indicatorPlan = getIndicatorPlan(rounds);
+    std::vector<CTile> res(c.getNumUsedTiles(), CTile(he));
+    parallelFor(0, c.getNumUsedTiles(), [&](int t) {
+      const CTile& threshold = maxes[groupOf[t]];
+      CTile vals(shifted.getTileByFlatIndex(t));
+      vals.setChainIndex(threshold.getChainIndex());
+      res[t] = tuner.compare(vals, threshold, indicatorPlan);
+    });
+    TTShape resShape(shape);
+    resShape.setAllUnusedSlotsUnknown();
+    return CTileTensor::createFromCTileVector(he, resShape, res);
+  }
+};
+
+} // namespace helayers
+
+#endif /* TUTORIALS_TOURNAMENT_EVALUATOR_H */
@@ -0,0 +1,259 @@
+//
+//  tut_10_transpose.cpp
+//  HELayers-Tutorials
+//
+
+#include "HELayers-Tutorials-Bridging-Header.h"
+
+#include <cmath>
+#include <map>
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "helayers/math/CTileTensor.h"
+#include "helayers/math/TTEncoder.h"
+#include "ParallelFor.h"
+
+// This tutorial shows how to transpose encrypted matrices using few
+// rotations.
+// In a d x d tile, element (i,j) sits in slot i + d*j. Transposing moves it
+// to slot j + d*i, i.e., rotates it by (j-i)*(d-1). All elements on the same
+// diagonal (same j-i) move by the same rotation, so a transpose is a sum of
+// 2d-1 masked rotations: sum_k rot(x, k*(d-1)) * mask_k.
+// Writing each k as a "giant step" plus a "baby step", the baby step
+// rotations of x are computed once and shared by all giant steps, and the
+// masks are pre-rotated to match. This takes about 2*sqrt(2d) rotations
+// instead of 2d-2.
+// A rotation costs one key switch only when there is a rotation key for its
+// exact step. With the default keys, for powers of 2, a rotation by another
+// step is composed of several key switches, one per nonzero digit of its
+// non-adjacent form. So we generate a key for each step the plan uses.
+
+using namespace std;
+using namespace helayers;
+
+// Transposes square d x d tiles, and tile tensors made of them.
+class TransposePlan
+{
+  const HeContext& he;
+  int d;
+
+  // Number of baby steps and giant steps.
+  int babySteps;
+  int giantSteps;
+
+  // Masks pre-encoded per chain index: masks[ci][p][q] is the mask for giant
+  // step p and baby step q, or null if that mask is all zeros.
+  map<int, vector<vector<shared_ptr<PTile>>>> masks;
+
+  static int getNumBabySteps(int d)
+  {
+    return (int)ceil(sqrt((double)(2 * d - 1)));
+  }
+
+  static int getNumGiantSteps(int d)
+  {
+    return (2 * d - 1 + getNumBabySteps(d) - 1) / getNumBabySteps(d);
+  }
+
+  // Returns the rotation of giant step p.
+  static int getGiantRotation(int d, int p)
+  {
+    return (getNumBabySteps(d) * p - (d - 1)) * (d - 1);
+  }
+
+  int getGiantRotation(int p) const { return getGiantRotation(d, p); }
+
+public:
+  /// @brief A constructor.
+  /// @param he The HeContext.
+  /// @param d  The tile dimension. d*d must equal the number of slots.
+  TransposePlan(const HeContext& he, int d) : he(he), d(d)
+  {
+    if (d * d != he.slotCount())
+      throw invalid_argument("TransposePlan: tile of " + to_string(d) + "x" +
+                             to_string(d) + " doesn't match slot count " +
+                             to_string(he.slotCount()));
+    babySteps = getNumBabySteps(d);
+    giantSteps = getNumGiantSteps(d);
+  }
+
+  /// @brief Returns the rotation steps that transposing d x d tiles uses.
+  /// With a rotation key for each, every rotation is a single key switch.
+  static vector<int> getRotationSteps(int d)
+  {
+    vector<int> res;
+    for (int q = 1; q < getNumBabySteps(d); ++q)
+      res.push_back(q * (d - 1));
+    for (int p = 0; p < getNumGiantSteps(d); ++p)
+      if (getGiantRotation(d, p) != 0)
+        res.push_back(getGiantRotation(d, p));
+    return res;
+  }
+
+  /// @brief Encodes the masks for inputs at the given chain index. Must be
+  /// called before transposing inputs at this chain index.
+  void prepare(int chainIndex)
+  {
+    if (masks.count(chainIndex) > 0)
+      return;
+    int n = d * d;
+    Encoder enc(he);
+    vector<vector<shared_ptr<PTile>>>& res = masks[chainIndex];
+    res.resize(giantSteps);
+    for (int p = 0; p < giantSteps; ++p) {
+      int giantRot = getGiantRotation(p);
+      for (int q = 0; q < babySteps; ++q) {
+        // Diagonal k = j - i of the source, shifted to [0, 2d-2].
+        int shiftedK = babySteps * p + q;
+        vector<double> mask(n, 0);
+        bool any = false;
+        // Destination slot a + d*c holds source element (c, a), with k = a-c.
+        for (int c = 0; c < d; ++c) {
+          int a = shiftedK - (d - 1) + c;
+          if (a < 0 || a >= d)
+            continue;
+          int dst = a + d * c;
+          // The mask is applied before the giant step rotation, so it's
+          // pre-rotated in the opposite direction.
+          mask[((dst + giantRot) % n + n) % n] = 1;
+          any = true;
+        }
+        if (!any) {
+          res[p].push_back(nullptr);
+          continue;
+        }
+        res[p].push_back(make_shared<PTile>(he));
+        enc.encode(*res[p].back(), mask, chainIndex);
+      }
+    }
+  }
+
+  /// @brief Returns the transpose of a d x d tile. Consumes one
+  /// multiplicative level.
+  CTile transposeTile(const CTile& src) const
+  {
+    auto it = masks.find(src.getChainIndex());
+    if (it == masks.end())
+      throw runtime_error("TransposePlan: masks for chain index " +
+                          to_string(src.getChainIndex()) +
+                          " were not prepared");
+    const vector<vector<shared_ptr<PTile>>>& m = it->second;
+
+    // Baby steps: rotations of the source by multiples of (d-1).
+    vector<CTile> baby(babySteps, src);
+    for (int q = 1; q < babySteps; ++q)
+      baby[q].rotate(q * (d - 1));
+
+    CTile res(he);
+    bool started = false;
+    for (int p = 0; p < giantSteps; ++p) {
+      CTile giant(he);
+      bool giantStarted = false;
+      for (int q = 0; q < babySteps; ++q) {
+        if (!m[p][q])
+          continue;
+        CTile term(baby[q]);
+        term.multiplyPlainRaw(*m[p][q]);
+        if (giantStarted) {
+          giant.addRaw(term);
+        } else {
+          giant = move(term);
+          giantStarted = true;
+        }
+      }
+      if (!giantStarted)
+        continue;
+      int giantRot = getGiantRotation(p);
+      if (giantRot != 0)
+        giant.rotate(giantRot);
+      if (started) {
+        res.addRaw(giant);
+      } else {
+        res = move(giant);
+        started = true;
+      }
+    }
+    res.rescale();
+    return res;
+  }
+
+  /// @brief Returns the transpose of a matrix packed in a 2-D tile tensor
+  /// with d x d tiles. Tile (a,b) of the source becomes tile (b,a) of the
+  /// result, transposed.
+  CTileTensor transpose(const CTileTensor& src)
+  {
+    const TTShape& shape = src.getShape();
+    always_assert(shape.getNumDims() == 2);
+    always_assert(shape.getDim(0).getTileSize() == d &&
+                  shape.getDim(1).getTileSize() == d);
+    prepare(src.getChainIndex());
+
+    vector<DimInt> ext = shape.getExternalSizes();
+    TTShape resShape(shape);
+    resShape.reorderDims({1, 0});
+    vector<CTile> tiles(src.getNumUsedTiles());
+    parallelFor(0, src.getNumUsedTiles(), [&](int t) {
+      int a = t % ext[0];
+      int b = t / ext[0];
+      tiles[b + ext[1] * a] = transposeTile(src.getTileByFlatIndex(t));
+    });
+    return CTileTensor::createFromCTileVector(he, resShape, tiles);
+  }
+
+  /// @brief Returns the number of rotations per tile. Each is a single key
+  /// switch with the rotation keys of getRotationSteps().
+  int getNumRotations() const { return (babySteps - 1) + giantSteps; }
+};
+
+void tut_10_run(HeContext& he);
+
+void tut_10_transpose()
+{
+  // As in tut_1_basics, let's choose the same HE CKKS setup
+  HeConfigRequirement requirement;
+  requirement.numSlots = 4096;
+  requirement.multiplicationDepth = 2;
+  requirement.fractionalPartPrecision = 40;
+  requirement.integerPartPrecision = 20;
+  requirement.securityLevel = 128;
+  // Unlike tut_1_basics, we ask for a rotation key for each step the
+  // transpose uses, rather than for the powers of 2.
+  requirement.publicFunctions.rotate = CUSTOM_ROTATIONS;
+  requirement.publicFunctions.rotationSteps =
+      TransposePlan::getRotationSteps(64);
+  shared_ptr<HeContext> hePtr = make_shared<SealCkksContext>();
+  hePtr->init(requirement);
+
+  // Let's also make sure we have enough security
+  always_assert(hePtr->getSecurityLevel() >= 128);
+
+  // and do some work
+  tut_10_run(*hePtr);
+}
+
+void tut_10_run(HeContext& he)
+{
+  TTEncoder enc(he);
+  TransposePlan plan(he, 64);
+  cout << "Rotations per tile, one key switch each: "
+       << plan.getNumRotations() << " (instead of " << 2 * 64 - 2 << ")"
+       << endl;
+
+  // A 100x150 matrix packed in 64x64 tiles, i.e., 2x3 tiles.
+  DoubleTensor vals({100, 150});
+  vals.initRandom(-1, 1);
+  TTShape shape({64, 64});
+  shape.setOriginalSizes({100, 150});
+  CTileTensor c(he);
+  enc.encodeEncrypt(c, shape, vals);
+
+  HELAYERS_TIMER_PUSH("transpose");
+  CTileTensor res = plan.transpose(c);
+  HELAYERS_TIMER_POP();
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("transpose");
+
+  vals.transpose();
+  enc.assertEquals(res, "transposed", vals, 1e-3);
+  cout << "\nTranspose worked correctly!" << endl;
+}
@@ -0,0 +1,251 @@
+//
+//  tut_11_unknown_slots.cpp
+//  HELayers-Tutorials
+//
+
+#include "HELayers-Tutorials-Bridging-Header.h"
+
+#include <cmath>
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+
+// This tutorial shows how to avoid clearing garbage slots when the garbage
+// can't affect the result.
+// Operations such as rotate-and-sum leave unknown values ("garbage") in slots
+// we don't use. Clearing them means multiplying by a 0/1 mask, which costs a
+// multiplicative level. A tile tensor tracks unknown slots per dimension and
+// clears them conservatively. Here we track them per slot, through every
+// operation, and clear only when garbage would reach a slot we actually use.
+// When a plaintext multiplication follows anyway, the mask is folded into it
+// and clearing costs nothing.
+
+using namespace std;
+using namespace helayers;
+
+// A CTile with per-slot knowledge of which slots hold garbage and which hold
+// an exact zero.
+class SlotTrackedCTile
+{
+  CTile tile;
+
+  // garbage[i] is true if slot i may hold an arbitrary value.
+  vector<bool> garbage;
+
+  // zero[i] is true if slot i holds an exact zero (the result of multiplying
+  // by a plaintext zero).
+  vector<bool> zero;
+
+  // Whether clearing of the garbage slots is pending, to be folded into the
+  // next plaintext multiplication.
+  bool clearPending = false;
+
+  // Number of masking multiplications done only to clear garbage.
+  int numClearMultiplications = 0;
+
+  static vector<bool> rotated(const vector<bool>& v, int rot)
+  {
+    int n = (int)v.size();
+    vector<bool> res(n);
+    for (int i = 0; i < n; ++i)
+      res[i] = v[((i + rot) % n + n) % n];
+    return res;
+  }
+
+  void applyMask(const vector<double>& vals)
+  {
+    Encoder enc(tile.getHeContext());
+    PTile p(tile.getHeContext());
+    enc.encode(p, vals, tile.getChainIndex());
+    tile.multiplyPlain(p);
+    for (size_t i = 0; i < vals.size(); ++i) {
+      if (vals[i] == 0) {
+        garbage[i] = false;
+        zero[i] = true;
+      } else {
+        zero[i] = false;
+      }
+    }
+  }
+
+public:
+  /// @brief Constructs a tracked tile.
+  /// @param tile    The tile.
+  /// @param garbage Which slots hold garbage.
+  SlotTrackedCTile(const CTile& tile, const vector<bool>& garbage)
+      : tile(tile), garbage(garbage), zero(garbage.size(), false)
+  {
+    always_assert(garbage.size() == (size_t)tile.slotCount());
+  }
+
+  void add(const SlotTrackedCTile& other)
+  {
+    always_assert(!clearPending && !other.clearPending);
+    tile.add(other.tile);
+    for (size_t i = 0; i < garbage.size(); ++i) {
+      garbage[i] = garbage[i] || other.garbage[i];
+      zero[i] = zero[i] && other.zero[i];
+    }
+  }
+
+  void multiply(const SlotTrackedCTile& other)
+  {
+    always_assert(!clearPending && !other.clearPending);
+    tile.multiply(other.tile);
+    for (size_t i = 0; i < garbage.size(); ++i) {
+      // Only an exact plaintext zero cancels garbage; an encrypted zero is
+      // only approximately zero.
+      bool g = (garbage[i] && !other.zero[i]) ||
+               (other.garbage[i] && !zero[i]);
+      zero[i] = (zero[i] && !other.garbage[i]) ||
+                (other.zero[i] && !garbage[i]);
+      garbage[i] = g;
+    }
+  }
+
+  /// @brief Multiplies by a plaintext. If clearing is pending, the clearing
+  /// mask is folded into "vals" so no extra level is consumed.
+  void multiplyPlain(vector<double> vals)
+  {
+    always_assert(vals.size() == garbage.size());
+    if (clearPending) {
+      for (size_t i = 0; i < vals.size(); ++i)
+        if (garbage[i])
+          vals[i] = 0;
+      clearPending = false;
+    }
+    applyMask(vals);
+  }
+
+  void rotate(int rot)
+  {
+    always_assert(!clearPending);
+    tile.rotate(rot);
+    garbage = rotated(garbage, rot);
+    zero = rotated(zero, rot);
+  }
+
+  void addScalar(double val)
+  {
+    always_assert(!clearPending);
+    tile.addScalar(val);
+    zero.assign(zero.size(), false);
+  }
+
+  /// @brief Sums "num" consecutive slots into the first one, for every slot,
+  /// as in CTile::innerSum(). num must be a power of 2.
+  void sumSlots(int num)
+  {
+    for (int rot = 1; rot < num; rot *= 2) {
+      SlotTrackedCTile shifted(*this);
+      shifted.rotate(rot);
+      add(shifted);
+    }
+  }
+
+  /// @brief Makes sure no garbage remains in the given slots. Does nothing if
+  /// these slots are already free of garbage. Otherwise, if "deferred" is
+  /// true, the clearing is folded into the next multiplyPlain(); if not, a
+  /// masking multiplication is done now.
+  void clearGarbage(const vector<bool>& usedSlots, bool deferred = false)
+  {
+    bool needed = false;
+    for (size_t i = 0; i < garbage.size(); ++i)
+      needed = needed || (garbage[i] && usedSlots[i]);
+    if (!needed)
+      return;
+    if (deferred) {
+      clearPending = true;
+      return;
+    }
+    vector<double> mask(garbage.size());
+    for (size_t i = 0; i < mask.size(); ++i)
+      mask[i] = garbage[i] ? 0 : 1;
+    applyMask(mask);
+    ++numClearMultiplications;
+  }
+
+  const CTile& getTile() const
+  {
+    always_assert(!clearPending);
+    return tile;
+  }
+  bool isGarbage(int slot) const { return garbage.at(slot); }
+  int getNumClearMultiplications() const { return numClearMultiplications; }
+};
+
+void tut_11_run(HeContext& he);
+
+void tut_11_unknown_slots()
+{
+  // As in tut_1_basics, let's choose the same HE CKKS setup
+  HeConfigRequirement requirement;
+  requirement.numSlots = 4096;
+  requirement.multiplicationDepth = 2;
+  requirement.fractionalPartPrecision = 40;
+  requirement.integerPartPrecision = 20;
+  requirement.securityLevel = 128;
+  shared_ptr<HeContext> hePtr = make_shared<SealCkksContext>();
+  hePtr->init(requirement);
+
+  // Let's also make sure we have enough security
+  always_assert(hePtr->getSecurityLevel() >= 128);
+
+  // and do some work
+  tut_11_run(*hePtr);
+}
+
+void tut_11_run(HeContext& he)
+{
+  Encoder encoder(he);
+  int n = he.slotCount();
+
+  // We hold 64 vectors of 8 elements, one per 64-slot block, in slots 0-7 of
+  // each block. Slots 8-63 of each block hold garbage left by an earlier
+  // computation.
+  vector<double> vals(n);
+  vector<bool> garbage(n);
+  for (int i = 0; i < n; ++i) {
+    garbage[i] = (i % 64) >= 8;
+    vals[i] = garbage[i] ? 100 : (i % 8) * 0.1;
+  }
+  CTile c(he);
+  encoder.encodeEncrypt(c, vals);
+  SlotTrackedCTile x(c, garbage);
+  int startChainIndex = c.getChainIndex();
+
+  // We want the sum of each vector, in the first slot of its block.
+  // Rotate-and-sum pulls garbage into slots 1-7 of each block, but the first
+  // slot only sums slots 0-7, so it stays clean.
+  x.sumSlots(8);
+  vector<bool> firstSlots(n);
+  for (int i = 0; i < n; i += 64)
+    firstSlots[i] = true;
+  x.clearGarbage(firstSlots);
+  always_assert(!x.isGarbage(0) && x.isGarbage(1));
+  always_assert(x.getNumClearMultiplications() == 0);
+
+  // Now we want to scale each sum by a per-block weight and then use all of
+  // slots 0-7. These do hold garbage, but the clearing is folded into the
+  // weights multiplication.
+  vector<bool> firstEight(n);
+  for (int i = 0; i < n; ++i)
+    firstEight[i] = (i % 64) < 8;
+  x.clearGarbage(firstEight, true);
+  vector<double> weights(n);
+  for (int i = 0; i < n; ++i)
+    weights[i] = 1.0 + (i / 64) * 0.01;
+  x.multiplyPlain(weights);
+  always_assert(!x.isGarbage(1));
+
+  // Only the weights multiplication consumed a level.
+  always_assert(x.getNumClearMultiplications() == 0);
+  always_assert(x.getTile().getChainIndex() == startChainIndex - 1);
+  vector<double> res = encoder.decryptDecodeDouble(x.getTile());
+  for (int b = 0; b < n / 64; ++b) {
+    double expected = 2.8 * (1.0 + b * 0.01);
+    always_assert(fabs(res[b * 64] - expected) < 1e-3);
+    always_assert(fabs(res[b * 64 + 1]) < 1e-3);
+  }
+  cout << "\nUnknown slot tracking worked correctly!" << endl;
+}
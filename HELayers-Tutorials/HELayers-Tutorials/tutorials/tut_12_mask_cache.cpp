@@ -0,0 +1,143 @@
+//
+//  tut_12_mask_cache.cpp
+//  HELayers-Tutorials
+//
+
+#include "HELayers-Tutorials-Bridging-Header.h"
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "helayers/math/CTileTensor.h"
+#include "helayers/math/TTEncoder.h"
+#include "MaskCache.h"
+#include "ParallelFor.h"
+#include "SlotMaps.h"
+
+// This tutorial shows how to avoid encoding the same masks over and over.
+// Clearing unused slots, extracting elements and duplicating values all
+// multiply by 0/1 masks. The same masks come up in every tile with the same
+// layout, in every layer and in every call, and encoding them again each
+// time can take a large part of the run time. A MaskCache encodes each
+// distinct mask once per chain index and scale, and shares it.
+
+using namespace std;
+using namespace helayers;
+
+// Returns, for every tile of a tensor packed with the given shape, the 0/1
+// mask of the slots holding tensor elements.
+vector<vector<double>> getUsedSlotsMasks(const HeContext& he,
+                                         const TTShape& shape)
+{
+  vector<vector<int64_t>> slotMap = getSlotElementMap(he, shape);
+  vector<vector<double>> res(slotMap.size());
+  for (size_t t = 0; t < slotMap.size(); ++t) {
+    res[t].resize(slotMap[t].size());
+    for (size_t s = 0; s < slotMap[t].size(); ++s)
+      res[t][s] = slotMap[t][s] >= 0 ? 1 : 0;
+  }
+  return res;
+}
+
+// Returns "c" with the slots holding no tensor element zeroed, taking the
+// masks from "cache". Tiles with the same layout share one encoded mask.
+CTileTensor clearUnusedSlots(const HeContext& he,
+                             const CTileTensor& c,
+                             const vector<vector<double>>& masks,
+                             MaskCache& cache)
+{
+  int chainIndex = c.getChainIndex();
+  vector<CTile> tiles(c.getNumUsedTiles(), CTile(he));
+  parallelFor(0, c.getNumUsedTiles(), [&](int t) {
+    tiles[t] = c.getTileByFlatIndex(t);
+    tiles[t].multiplyPlain(*cache.getMask(masks[t], chainIndex));
+  });
+  return CTileTensor::createFromCTileVector(he, c.getShape(), tiles);
+}
+
+// The same, encoding every mask on every call.
+CTileTensor clearUnusedSlotsUncached(const HeContext& he,
+                                     const CTileTensor& c,
+                                     const vector<vector<double>>& masks)
+{
+  int chainIndex = c.getChainIndex();
+  vector<CTile> tiles(c.getNumUsedTiles(), CTile(he));
+  parallelFor(0, c.getNumUsedTiles(), [&](int t) {
+    Encoder enc(he);
+    PTile mask(he);
+    enc.encode(mask, masks[t], chainIndex);
+    tiles[t] = c.getTileByFlatIndex(t);
+    tiles[t].multiplyPlain(mask);
+  });
+  return CTileTensor::createFromCTileVector(he, c.getShape(), tiles);
+}
+
+void tut_12_run(HeContext& he);
+
+void tut_12_mask_cache()
+{
+  // As in tut_1_basics, let's choose the same HE CKKS setup
+  HeConfigRequirement requirement;
+  requirement.numSlots = 4096;
+  requirement.multiplicationDepth = 2;
+  requirement.fractionalPartPrecision = 40;
+  requirement.integerPartPrecision = 20;
+  requirement.securityLevel = 128;
+  shared_ptr<HeContext> hePtr = make_shared<SealCkksContext>();
+  hePtr->init(requirement);
+
+  // Let's also make sure we have enough security
+  always_assert(hePtr->getSecurityLevel() >= 128);
+
+  // and do some work
+  tut_12_run(*hePtr);
+}
+
+void tut_12_run(HeContext& he)
+{
+  TTEncoder enc(he);
+
+  // A 30x1000 matrix packed in 16x256 tiles, i.e., 2x4 tiles. The tiles of
+  // the last row and the last column are partially used.
+  TTShape shape({16, 256});
+  shape.setOriginalSizes({30, 1000});
+  vector<vector<double>> masks = getUsedSlotsMasks(he, shape);
+
+  // We process a stream of 8 such matrices.
+  MaskCache cache(he);
+  for (int i = 0; i < 8; ++i) {
+    DoubleTensor vals({30, 1000});
+    vals.initRandom(-1, 1);
+    CTileTensor c(he);
+    enc.encodeEncrypt(c, shape, vals);
+
+    HELAYERS_TIMER_PUSH("uncached");
+    CTileTensor res1 = clearUnusedSlotsUncached(he, c, masks);
+    HELAYERS_TIMER_POP();
+
+    HELAYERS_TIMER_PUSH("cached");
+    CTileTensor res2 = clearUnusedSlots(he, c, masks, cache);
+    HELAYERS_TIMER_POP();
+
+    enc.assertEquals(res1, "uncached", vals, 1e-3);
+    enc.assertEquals(res2, "cached", vals, 1e-3);
+  }
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("uncached");
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("cached");
+
+  // The 8 tiles have only 4 distinct layouts: full, partial rows, partial
+  // columns, and both. So only 4 masks were ever encoded.
+  cout << "Mask cache: " << cache.getNumHits() << " hits, "
+       << cache.getNumMisses() << " misses, " << cache.size() << " masks"
+       << endl;
+  always_assert(cache.size() == 4);
+  always_assert(cache.getNumHits() + cache.getNumMisses() == 8 * 8);
+
+  // Masks at other chain indices or scales are separate entries.
+  int ci = he.getTopChainIndex() - 1;
+  shared_ptr<const PTile> m1 = cache.getScalarMask(0.5, ci);
+  shared_ptr<const PTile> m2 = cache.getScalarMask(0.5, ci);
+  always_assert(m1 == m2);
+  always_assert(cache.getScalarMask(0.5) != m1);
+
+  cout << "\nMask cache worked correctly!" << endl;
+}
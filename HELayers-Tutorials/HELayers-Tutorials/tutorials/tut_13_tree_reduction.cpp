@@ -0,0 +1,190 @@
+//
+//  tut_13_tree_reduction.cpp
+//  HELayers-Tutorials
+//
+
+#include "HELayers-Tutorials-Bridging-Header.h"
+
+#include <functional>
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "helayers/math/CTileTensor.h"
+#include "helayers/math/TTEncoder.h"
+#include "ParallelFor.h"
+#include "ReductionUtils.h"
+
+// This tutorial shows how to reduce a tile tensor over a dimension as a
+// balanced tree.
+// Summing or multiplying n tiles one after the other takes n-1 sequential
+// steps, and n-1 multiplicative levels for a product. Combining them in
+// pairs, then pairs of pairs, and so on, takes only log2(n) steps, each made
+// of independent operations across tiles and across all the groups being
+// reduced, which run in parallel. Only log2(n) levels are consumed by a
+// product.
+// When the dimension also spans slots inside the tiles, the tiles are summed
+// first and the in-tile rotate-and-sum is done once per group, rather than
+// rotating every tile and summing afterwards. Rotations are much more
+// expensive than additions, so this order is always the cheaper one.
+
+using namespace std;
+using namespace helayers;
+
+// Reduces each group of tiles into its first tile, as a balanced tree. All
+// the pairs of a tree level, across all groups, are combined in parallel.
+void treeReduce(vector<CTile>& tiles,
+                const vector<vector<int>>& groups,
+                const function<void(CTile&, const CTile&)>& op)
+{
+  size_t maxSize = 0;
+  for (const vector<int>& g : groups)
+    maxSize = max(maxSize, g.size());
+  for (size_t step = 1; step < maxSize; step *= 2) {
+    vector<pair<int, int>> pairs;
+    for (const vector<int>& g : groups)
+      for (size_t i = 0; i + step < g.size(); i += 2 * step)
+        pairs.emplace_back(g[i], g[i + step]);
+    parallelFor(0, (int)pairs.size(), [&](int p) {
+      op(tiles[pairs[p].first], tiles[pairs[p].second]);
+    });
+  }
+}
+
+// Returns the sum of "c" over "dim". The result has original size 1 along
+// dim, with unknown values in the remaining slots of that dim.
+// The tile size along dim must be a power of 2, and the unused slots of dim
+// must hold zeros.
+CTileTensor treeSumOverDim(const HeContext& he,
+                           const CTileTensor& c,
+                           int dim)
+{
+  const TTShape& shape = c.getShape();
+  always_assert(!shape.getDim(dim).getAreUnusedSlotsUnknown());
+  vector<vector<int>> groups = getReductionGroups(shape, dim);
+  vector<CTile> tiles(c.getNumUsedTiles(), CTile(he));
+  parallelFor(0, c.getNumUsedTiles(), [&](int t) {
+    tiles[t] = c.getTileByFlatIndex(t);
+  });
+
+  // Sum the tiles of each group.
+  treeReduce(tiles, groups, [](CTile& a, const CTile& b) { a.add(b); });
+
+  // Sum inside the tiles, once per group. In the first order layout, moving
+  // one step along dim moves slotStride slots.
+  int slotStride = 1;
+  for (int d = 0; d < dim; ++d)
+    slotStride *= shape.getDim(d).getTileSize();
+  int tileSize = shape.getDim(dim).getTileSize();
+  always_assert((tileSize & (tileSize - 1)) == 0);
+  vector<CTile> res(groups.size(), CTile(he));
+  parallelFor(0, (int)groups.size(), [&](int g) {
+    res[g] = move(tiles[groups[g][0]]);
+    for (int rot = 1; rot < tileSize; rot *= 2) {
+      CTile shifted(res[g]);
+      shifted.rotate(rot * slotStride);
+      res[g].add(shifted);
+    }
+  });
+
+  TTShape resShape(shape);
+  resShape.getDim(dim) = TTDim(1, tileSize, 1, tileSize > 1);
+  return CTileTensor::createFromCTileVector(he, resShape, res);
+}
+
+// Returns the product of "c" over "dim", consuming only log2 of the external
+// size along dim levels. The tile size along dim must be 1.
+CTileTensor treeMultiplyOverDim(const HeContext& he,
+                                const CTileTensor& c,
+                                int dim)
+{
+  const TTShape& shape = c.getShape();
+  always_assert(shape.getDim(dim).getTileSize() == 1);
+  vector<vector<int>> groups = getReductionGroups(shape, dim);
+  vector<CTile> tiles(c.getNumUsedTiles(), CTile(he));
+  parallelFor(0, c.getNumUsedTiles(), [&](int t) {
+    tiles[t] = c.getTileByFlatIndex(t);
+  });
+
+  treeReduce(
+      tiles, groups, [](CTile& a, const CTile& b) { a.multiply(b); });
+
+  vector<CTile> res;
+  for (const vector<int>& g : groups)
+    res.push_back(move(tiles[g[0]]));
+  TTShape resShape(shape);
+  resShape.getDim(dim) = TTDim(1, 1);
+  return CTileTensor::createFromCTileVector(he, resShape, res);
+}
+
+void tut_13_run(HeContext& he);
+
+void tut_13_tree_reduction()
+{
+  // As in tut_1_basics, let's choose the same HE CKKS setup
+  HeConfigRequirement requirement;
+  requirement.numSlots = 4096;
+  requirement.multiplicationDepth = 2;
+  requirement.fractionalPartPrecision = 40;
+  requirement.integerPartPrecision = 20;
+  requirement.securityLevel = 128;
+  shared_ptr<HeContext> hePtr = make_shared<SealCkksContext>();
+  hePtr->init(requirement);
+
+  // Let's also make sure we have enough security
+  always_assert(hePtr->getSecurityLevel() >= 128);
+
+  // and do some work
+  tut_13_run(*hePtr);
+}
+
+void tut_13_run(HeContext& he)
+{
+  TTEncoder enc(he);
+
+  // Sum the rows of a 64x4096 matrix, packed in 8x512 tiles (8x8 tiles).
+  DoubleTensor vals({64, 4096});
+  vals.initRandom(-1, 1);
+  TTShape shape({8, 512});
+  shape.setOriginalSizes({64, 4096});
+  CTileTensor c(he);
+  enc.encodeEncrypt(c, shape, vals);
+
+  HELAYERS_TIMER_PUSH("tree sum");
+  CTileTensor sum = treeSumOverDim(he, c, 1);
+  HELAYERS_TIMER_POP();
+
+  HELAYERS_TIMER_PUSH("sumOverDim");
+  CTileTensor libSum = c.getSumOverDim(1);
+  HELAYERS_TIMER_POP();
+
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("tree sum");
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("sumOverDim");
+
+  DoubleTensor expected({64, 1});
+  for (DimInt i = 0; i < 64; ++i)
+    for (DimInt j = 0; j < 4096; ++j)
+      expected.at(i, 0) += vals.at(i, j);
+  enc.assertEquals(sum, "tree sum", expected, 1e-2);
+  enc.assertEquals(libSum, "sumOverDim", expected, 1e-2);
+
+  // Multiply 4 vectors of 4096 elements, one per tile. The tree takes 2
+  // levels where a chain would take 3.
+  DoubleTensor factors({4096, 4});
+  factors.initRandom(0.5, 1.5);
+  TTShape factorsShape({4096, 1});
+  factorsShape.setOriginalSizes({4096, 4});
+  CTileTensor f(he);
+  enc.encodeEncrypt(f, factorsShape, factors);
+  CTileTensor prod = treeMultiplyOverDim(he, f, 1);
+  always_assert(prod.getChainIndex() == f.getChainIndex() - 2);
+
+  DoubleTensor expectedProd({4096, 1});
+  for (DimInt i = 0; i < 4096; ++i) {
+    expectedProd.at(i, 0) = 1;
+    for (DimInt j = 0; j < 4; ++j)
+      expectedProd.at(i, 0) *= factors.at(i, j);
+  }
+  enc.assertEquals(prod, "tree product", expectedProd, 1e-3);
+
+  cout << "\nTree reduction worked correctly!" << endl;
+}
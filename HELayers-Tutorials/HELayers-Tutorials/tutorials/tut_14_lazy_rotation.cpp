@@ -0,0 +1,136 @@
+//
+//  tut_14_lazy_rotation.cpp
+//  HELayers-Tutorials
+//
+
+#include "HELayers-Tutorials-Bridging-Header.h"
+
+#include <cmath>
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "LazyRotatedCTile.h"
+
+// This tutorial shows how to save rotations by deferring them.
+// Each rotation of a ciphertext costs a key switch. Code that rotates by a,
+// then by b, pays twice, and code that rotates by k, masks, and rotates back
+// pays twice for a net rotation of zero. A LazyRotatedCTile only records
+// rotations, combines them, and performs a single rotation when the value is
+// actually needed. Plaintext operands are rotated on the client side instead.
+
+using namespace std;
+using namespace helayers;
+
+// Returns v rotated as in CTile::rotate().
+vector<double> rotated(const vector<double>& v, int rot)
+{
+  int n = (int)v.size();
+  vector<double> res(n);
+  for (int i = 0; i < n; ++i)
+    res[i] = v[((i + rot) % n + n) % n];
+  return res;
+}
+
+void tut_14_run(HeContext& he);
+
+void tut_14_lazy_rotation()
+{
+  // As in tut_1_basics, let's choose the same HE CKKS setup
+  HeConfigRequirement requirement;
+  requirement.numSlots = 4096;
+  requirement.multiplicationDepth = 2;
+  requirement.fractionalPartPrecision = 40;
+  requirement.integerPartPrecision = 20;
+  requirement.securityLevel = 128;
+  shared_ptr<HeContext> hePtr = make_shared<SealCkksContext>();
+  hePtr->init(requirement);
+
+  // Let's also make sure we have enough security
+  always_assert(hePtr->getSecurityLevel() >= 128);
+
+  // and do some work
+  tut_14_run(*hePtr);
+}
+
+void tut_14_run(HeContext& he)
+{
+  Encoder encoder(he);
+  int n = he.slotCount();
+  vector<double> vals(n), w(n), bias(n);
+  for (int i = 0; i < n; ++i) {
+    vals[i] = sin(i * 0.01);
+    w[i] = (i % 16) < 4 ? 1 : 0;
+    bias[i] = 0.001 * (i % 7);
+  }
+  CTile c(he);
+  encoder.encodeEncrypt(c, vals);
+
+  // Rotations that cancel out cost nothing.
+  LazyRotatedCTile x(c);
+  x.rotate(3);
+  x.rotate(5);
+  x.rotate(-8);
+  encoder.assertEquals(x.get(), "cancelled rotations", vals, 1e-3);
+  always_assert(x.getNumRotations() == 0);
+
+  // Extract a window: rotate by 12, mask, and rotate back. The mask is
+  // rotated on the client, so this needs no rotation at all.
+  LazyRotatedCTile window(c);
+  window.rotate(12);
+  window.multiplyPlain(w);
+  window.rotate(-12);
+  vector<double> expected = rotated(vals, 12);
+  for (int i = 0; i < n; ++i)
+    expected[i] *= w[i];
+  expected = rotated(expected, -12);
+  encoder.assertEquals(window.get(), "window", expected, 1e-3);
+  always_assert(window.getNumRotations() == 0);
+
+  // rot(rot(x, 5) * w + bias, 9): the two rotations become one.
+  HELAYERS_TIMER_PUSH("eager");
+  CTile eager(c);
+  eager.rotate(5);
+  PTile wP(he), biasP(he);
+  encoder.encode(wP, w, eager.getChainIndex());
+  eager.multiplyPlain(wP);
+  encoder.encode(biasP, bias, eager.getChainIndex());
+  eager.addPlain(biasP);
+  eager.rotate(9);
+  HELAYERS_TIMER_POP();
+
+  HELAYERS_TIMER_PUSH("lazy");
+  LazyRotatedCTile lazy(c);
+  lazy.rotate(5);
+  lazy.multiplyPlain(w);
+  lazy.addPlain(bias);
+  lazy.rotate(9);
+  const CTile& lazyRes = lazy.get();
+  HELAYERS_TIMER_POP();
+  always_assert(lazy.getNumRotations() == 1);
+
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("eager");
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("lazy");
+
+  expected = rotated(vals, 5);
+  for (int i = 0; i < n; ++i)
+    expected[i] = expected[i] * w[i] + bias[i];
+  expected = rotated(expected, 9);
+  encoder.assertEquals(eager, "eager", expected, 1e-3);
+  encoder.assertEquals(lazyRes, "lazy", expected, 1e-3);
+
+  // Adding tiles with different offsets rotates only one of them. Here a is
+  // rotated by -1 to match b, leaving b's pending rotation by 8, one key
+  // switch, rather than a's by 7 = 8 - 1, which takes two.
+  LazyRotatedCTile a(c), b(c);
+  a.rotate(7);
+  b.rotate(8);
+  a.add(b);
+  always_assert(a.getOffset() == 8 && a.getNumRotations() == 1);
+  expected = rotated(vals, 7);
+  vector<double> expectedB = rotated(vals, 8);
+  for (int i = 0; i < n; ++i)
+    expected[i] += expectedB[i];
+  encoder.assertEquals(a.get(), "sum of rotations", expected, 1e-3);
+
+  cout << "\nLazy rotation worked correctly!" << endl;
+}
@@ -0,0 +1,114 @@
+//
+//  tut_15_expression_templates.cpp
+//  HELayers-Tutorials
+//
+
+#include "HELayers-Tutorials-Bridging-Header.h"
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "helayers/math/TTEncoder.h"
+#include "TileExpr.h"
+
+// This tutorial shows how to evaluate element-wise tile tensor expressions
+// in a single pass.
+// Writing a.getMultiply(b).getAdd(c.getMultiplyPlain(w)) creates a full
+// intermediate tensor per step, and relinearizes and rescales each product
+// separately. With the expression templates of TileExpr.h, the same
+// expression is written lazy(a) * lazy(b) + lazy(c) * lazy(w). It's built at
+// compile time and computed by evaluate() tile by tile, with one
+// relinearization and one rescale per output tile.
+
+using namespace std;
+using namespace helayers;
+using namespace helayers::expr;
+
+void tut_15_run(HeContext& he);
+
+void tut_15_expression_templates()
+{
+  // As in tut_1_basics, let's choose the same HE CKKS setup
+  HeConfigRequirement requirement;
+  requirement.numSlots = 4096;
+  requirement.multiplicationDepth = 2;
+  requirement.fractionalPartPrecision = 40;
+  requirement.integerPartPrecision = 20;
+  requirement.securityLevel = 128;
+  shared_ptr<HeContext> hePtr = make_shared<SealCkksContext>();
+  hePtr->init(requirement);
+
+  // Let's also make sure we have enough security
+  always_assert(hePtr->getSecurityLevel() >= 128);
+
+  // and do some work
+  tut_15_run(*hePtr);
+}
+
+void tut_15_run(HeContext& he)
+{
+  TTEncoder enc(he);
+  TTShape shape({64, 64});
+  shape.setOriginalSizes({256, 256});
+
+  DoubleTensor a({256, 256}), b({256, 256}), c({256, 256}), d({256, 256}),
+      w({256, 256});
+  for (DoubleTensor* t : {&a, &b, &c, &d, &w})
+    t->initRandom(-1, 1);
+  CTileTensor aC(he), bC(he), cC(he), dC(he);
+  enc.encodeEncrypt(aC, shape, a);
+  enc.encodeEncrypt(bC, shape, b);
+  enc.encodeEncrypt(cC, shape, c);
+  enc.encodeEncrypt(dC, shape, d);
+  PTileTensor wP(he);
+  enc.encode(wP, shape, w);
+
+  // a * b + c * w - d
+  DoubleTensor expected(a);
+  expected.elementMultiply(b);
+  DoubleTensor cw(c);
+  cw.elementMultiply(w);
+  expected.elementAdd(cw);
+  expected.elementSub(d);
+
+  HELAYERS_TIMER_PUSH("step by step");
+  CTileTensor stepByStep =
+      aC.getMultiply(bC).getAdd(cC.getMultiplyPlain(wP)).getSub(dC);
+  HELAYERS_TIMER_POP();
+
+  HELAYERS_TIMER_PUSH("fused");
+  CTileTensor fused =
+      evaluate(lazy(aC) * lazy(bC) + lazy(cC) * lazy(wP) - lazy(dC));
+  HELAYERS_TIMER_POP();
+
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("step by step");
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("fused");
+
+  enc.assertEquals(stepByStep, "step by step", expected, 1e-3);
+  enc.assertEquals(fused, "fused", expected, 1e-3);
+  always_assert(fused.getChainIndex() == stepByStep.getChainIndex());
+
+  // Operands of different depths are lowered to match: a * b * c multiplies
+  // the settled a * b by c, one level above it.
+  DoubleTensor abc(a);
+  abc.elementMultiply(b);
+  abc.elementMultiply(c);
+  enc.assertEquals(
+      evaluate(lazy(aC) * lazy(bC) * lazy(cC)), "a * b * c", abc, 1e-3);
+
+  // (a * b) + c adds c to the product after the product is rescaled.
+  DoubleTensor abPlusC(a);
+  abPlusC.elementMultiply(b);
+  abPlusC.elementAdd(c);
+  enc.assertEquals(
+      evaluate((lazy(aC) * lazy(bC)) + lazy(cC)), "(a * b) + c", abPlusC, 1e-3);
+
+  // An expression may be kept and evaluated later. A temporary operand is
+  // then owned by the expression, so it doesn't dangle.
+  auto sumTimesC = lazy(aC.getAdd(bC)) * lazy(cC);
+  DoubleTensor abTimesC(a);
+  abTimesC.elementAdd(b);
+  abTimesC.elementMultiply(c);
+  enc.assertEquals(evaluate(sumTimesC), "(a + b) * c", abTimesC, 1e-3);
+
+  cout << "\nExpression templates worked correctly!" << endl;
+}
@@ -0,0 +1,93 @@
+//
+//  tut_16_static_dispatch.cpp
+//  HELayers-Tutorials
+//
+
+#include "HELayers-Tutorials-Bridging-Header.h"
+
+#include <cmath>
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/seal/SealCkksCiphertext.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "CTileT.h"
+
+// This tutorial shows how to skip the per-operation dispatch overhead of
+// CTile when the backend is known at compile time.
+// Every CTile operation calls a virtual method of the backend ciphertext,
+// after checking whether any adjustment is needed. For cheap operations
+// such as add and negate this overhead is noticeable. CTileT<Backend>, from
+// CTileT.h, calls the backend directly, and converts to and from CTile for
+// use with generic code.
+
+using namespace std;
+using namespace helayers;
+
+typedef CTileT<SealCkksCiphertext> SealCTile;
+
+// A generic function, working on any CTile.
+double decryptFirstSlot(const HeContext& he, const CTile& c)
+{
+  Encoder enc(he);
+  return enc.decryptDecodeDouble(c)[0];
+}
+
+void tut_16_run(HeContext& he);
+
+void tut_16_static_dispatch()
+{
+  // As in tut_1_basics, let's choose the same HE CKKS setup
+  HeConfigRequirement requirement;
+  requirement.numSlots = 4096;
+  requirement.multiplicationDepth = 2;
+  requirement.fractionalPartPrecision = 40;
+  requirement.integerPartPrecision = 20;
+  requirement.securityLevel = 128;
+  shared_ptr<HeContext> hePtr = make_shared<SealCkksContext>();
+  hePtr->init(requirement);
+
+  // Let's also make sure we have enough security
+  always_assert(hePtr->getSecurityLevel() >= 128);
+
+  // and do some work
+  tut_16_run(*hePtr);
+}
+
+void tut_16_run(HeContext& he)
+{
+  Encoder encoder(he);
+  CTile x(he), y(he);
+  encoder.encodeEncrypt(x, vector<double>{0.001});
+  encoder.encodeEncrypt(y, vector<double>{0.002});
+  const int numOps = 10000;
+
+  // Many cheap operations with regular CTiles.
+  HELAYERS_TIMER_PUSH("CTile");
+  CTile acc(x);
+  for (int i = 0; i < numOps; ++i) {
+    acc.add(y);
+    acc.negate();
+  }
+  HELAYERS_TIMER_POP();
+
+  // The same with the SEAL backend known at compile time.
+  HELAYERS_TIMER_PUSH("CTileT");
+  SealCTile accT(x);
+  SealCTile yT(y);
+  for (int i = 0; i < numOps; ++i) {
+    accT.add(yT);
+    accT.negate();
+  }
+  HELAYERS_TIMER_POP();
+
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("CTile");
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("CTileT");
+
+  // After an even number of (add, negate) pairs, acc = x.
+  double res = decryptFirstSlot(he, acc);
+  double resT = decryptFirstSlot(he, accT.asCTile());
+  always_assert(fabs(res - 0.001) < 1e-4);
+  always_assert(fabs(resT - res) < 1e-6);
+
+  cout << "\nStatic dispatch worked correctly!" << endl;
+}
@@ -0,0 +1,108 @@
+//
+//  tut_17_move_aware.cpp
+//  HELayers-Tutorials
+//
+
+#include "HELayers-Tutorials-Bridging-Header.h"
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "helayers/math/TTEncoder.h"
+#include "MoveAware.h"
+
+// This tutorial shows how to chain out-of-place tile tensor operations
+// without copying temporaries.
+// Each CTileTensor::getX() method copies its receiver, even when the
+// receiver is a temporary about to be destroyed, as in
+// a.getAdd(b).getMultiply(c). The free functions of MoveAware.h take the
+// tensor by value, so temporaries are moved in and operated on in place.
+
+using namespace std;
+using namespace helayers;
+
+void tut_17_run(HeContext& he);
+
+void tut_17_move_aware()
+{
+  // As in tut_1_basics, let's choose the same HE CKKS setup
+  HeConfigRequirement requirement;
+  requirement.numSlots = 4096;
+  requirement.multiplicationDepth = 2;
+  requirement.fractionalPartPrecision = 40;
+  requirement.integerPartPrecision = 20;
+  requirement.securityLevel = 128;
+  shared_ptr<HeContext> hePtr = make_shared<SealCkksContext>();
+  hePtr->init(requirement);
+
+  // Let's also make sure we have enough security
+  always_assert(hePtr->getSecurityLevel() >= 128);
+
+  // and do some work
+  tut_17_run(*hePtr);
+}
+
+void tut_17_run(HeContext& he)
+{
+  TTEncoder enc(he);
+  TTFunctionEvaluator fe(he);
+  TTShape shape({64, 64});
+  shape.setOriginalSizes({256, 256});
+
+  DoubleTensor a({256, 256}), b({256, 256}), c({256, 256});
+  a.initRandom(-0.5, 0.5);
+  b.initRandom(-0.5, 0.5);
+  c.initRandom(-1, 1);
+  CTileTensor aC(he), bC(he), cC(he);
+  enc.encodeEncrypt(aC, shape, a);
+  enc.encodeEncrypt(bC, shape, b);
+  enc.encodeEncrypt(cC, shape, c);
+
+  // (a + b)^2 * c, summed over the columns.
+  DoubleTensor expected({256, 1});
+  for (DimInt i = 0; i < 256; ++i)
+    for (DimInt j = 0; j < 256; ++j) {
+      double s = a.at(i, j) + b.at(i, j);
+      expected.at(i, 0) += s * s * c.at(i, j);
+    }
+
+  // Each step copies the temporary result of the previous one.
+  HELAYERS_TIMER_PUSH("copying");
+  CTileTensor copying =
+      aC.getAdd(bC).getSquare().getMultiply(cC).getSumOverDim(1);
+  HELAYERS_TIMER_POP();
+
+  // Each step works in place on the storage of the previous one. Only the
+  // first step, whose input aC is still needed, copies.
+  HELAYERS_TIMER_PUSH("moving");
+  CTileTensor moving =
+      getSumOverDim(getMultiply(getSquare(getAdd(aC, bC)), cC), 1);
+  HELAYERS_TIMER_POP();
+
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("copying");
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("moving");
+
+  enc.assertEquals(copying, "copying", expected, 1e-3);
+  enc.assertEquals(moving, "moving", expected, 1e-3);
+
+  // Operations with a plaintext operand reuse the ciphertext's storage too:
+  // w * (a + b - w), with w a plaintext.
+  DoubleTensor w({256, 256});
+  w.initRandom(-1, 1);
+  PTileTensor wP(he);
+  enc.encode(wP, shape, w);
+  DoubleTensor expectedPlain(a);
+  expectedPlain.elementAdd(b);
+  expectedPlain.elementSub(w);
+  expectedPlain.elementMultiply(w);
+  CTileTensor plainRes = getMultiplyPlain(wP, getSubPlain(getAdd(aC, bC), wP));
+  enc.assertEquals(plainRes, "plain operands", expectedPlain, 1e-3);
+
+  // A tensor that's no longer needed can be moved in too, and function
+  // evaluations work the same way.
+  DoubleTensor expectedSq(c);
+  expectedSq.elementMultiply(c);
+  CTileTensor sq = getPow(fe, move(cC), 2);
+  enc.assertEquals(sq, "pow", expectedSq, 1e-3);
+
+  cout << "\nMove-aware operations worked correctly!" << endl;
+}
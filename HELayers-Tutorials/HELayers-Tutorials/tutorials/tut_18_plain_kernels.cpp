@@ -0,0 +1,72 @@
+//
+//  tut_18_plain_kernels.cpp
+//  HELayers-Tutorials
+//
+
+#include "HELayers-Tutorials-Bridging-Header.h"
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/math/DoubleTensor.h"
+#include "PlainKernels.h"
+
+// This tutorial shows how to speed up the plaintext computations done on the
+// client, such as computing the expected results of an encrypted
+// computation.
+// DoubleTensor methods are generic and visit elements one by one. For large
+// tensors the client side can become the bottleneck. The kernels in
+// PlainKernels.h compute the same results directly on the tensor buffer, in
+// cache-sized blocks, spread over all cores.
+
+using namespace std;
+using namespace helayers;
+
+void tut_18_plain_kernels()
+{
+  // Matrix multiplication.
+  DoubleTensor a({300, 400}), b({400, 200});
+  a.initRandom(-1, 1);
+  b.initRandom(-1, 1);
+  DoubleTensor expected;
+  HELAYERS_TIMER_PUSH("getMatrixMultiply");
+  a.getMatrixMultiply(b, expected);
+  HELAYERS_TIMER_POP();
+  HELAYERS_TIMER_PUSH("fastMatrixMultiply");
+  DoubleTensor res = fastMatrixMultiply(a, b);
+  HELAYERS_TIMER_POP();
+  expected.assertEquals(res, "matrix multiply", 1e-9);
+
+  // Transpose.
+  DoubleTensor t(a);
+  HELAYERS_TIMER_PUSH("transpose");
+  t.transpose();
+  HELAYERS_TIMER_POP();
+  HELAYERS_TIMER_PUSH("fastTranspose");
+  DoubleTensor fastT = fastTranspose(a);
+  HELAYERS_TIMER_POP();
+  t.assertEquals(fastT, "transpose", 0);
+
+  // Convolution of a batch of 4 32x32x3 images with 16 3x3 filters, stride 2
+  // and padding.
+  DoubleTensor images({32, 32, 3, 4}), filters({3, 3, 3, 16}), biases({16});
+  images.initRandom(-1, 1);
+  filters.initRandom(-1, 1);
+  biases.initRandom(-1, 1);
+  Padding2d padding(1, 1, 1, 1);
+  DoubleTensor expectedConv;
+  HELAYERS_TIMER_PUSH("calcConvolution");
+  images.calcConvolution(expectedConv, filters, biases, 2, 2, padding);
+  HELAYERS_TIMER_POP();
+  HELAYERS_TIMER_PUSH("fastConvolution");
+  DoubleTensor conv = fastConvolution(images, filters, biases, 2, 2, padding);
+  HELAYERS_TIMER_POP();
+  expectedConv.assertEquals(conv, "convolution", 1e-9);
+
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("getMatrixMultiply");
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("fastMatrixMultiply");
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("transpose");
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("fastTranspose");
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("calcConvolution");
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("fastConvolution");
+
+  cout << "\nPlaintext kernels worked correctly!" << endl;
+}
@@ -0,0 +1,83 @@
+//
+//  tut_19_packing_plans.cpp
+//  HELayers-Tutorials
+//
+
+#include "HELayers-Tutorials-Bridging-Header.h"
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "helayers/math/TTEncoder.h"
+#include "PackingPlan.h"
+
+// This tutorial shows how to pack many tensors of the same shape quickly.
+// For every tensor it encodes, TTEncoder iterates over the shape to find the
+// tile and slot of each element. When the shape doesn't change between
+// calls, as for the inputs of a model, this mapping can be computed once. A
+// PackingPlan stores it as flat index arrays, and packs and unpacks tensors
+// with plain gathers and scatters, on all tiles in parallel.
+
+using namespace std;
+using namespace helayers;
+
+void tut_19_run(HeContext& he);
+
+void tut_19_packing_plans()
+{
+  // As in tut_1_basics, let's choose the same HE CKKS setup
+  HeConfigRequirement requirement;
+  requirement.numSlots = 4096;
+  requirement.multiplicationDepth = 2;
+  requirement.fractionalPartPrecision = 40;
+  requirement.integerPartPrecision = 20;
+  requirement.securityLevel = 128;
+  shared_ptr<HeContext> hePtr = make_shared<SealCkksContext>();
+  hePtr->init(requirement);
+
+  // Let's also make sure we have enough security
+  always_assert(hePtr->getSecurityLevel() >= 128);
+
+  // and do some work
+  tut_19_run(*hePtr);
+}
+
+void tut_19_run(HeContext& he)
+{
+  TTEncoder enc(he);
+  PackingPlanCache plans(he);
+
+  // A stream of 4-D inputs: batches of 16 images of 28x28x3, packed with
+  // interleaving along the image dims, as for convolution.
+  TTShape shape({8, 8, 4, 16});
+  shape.setOriginalSizes({28, 28, 3, 16});
+  shape.getDim(0).setInterleaved(true);
+  shape.getDim(1).setInterleaved(true);
+
+  for (int i = 0; i < 4; ++i) {
+    DoubleTensor images({28, 28, 3, 16});
+    images.initRandom(-1, 1);
+
+    HELAYERS_TIMER_PUSH("TTEncoder");
+    CTileTensor c1(he);
+    enc.encodeEncrypt(c1, shape, images);
+    DoubleTensor res1 = enc.decryptDecodeDouble(c1);
+    HELAYERS_TIMER_POP();
+
+    HELAYERS_TIMER_PUSH("PackingPlan");
+    CTileTensor c2 = plans.encodeEncrypt(shape, images);
+    DoubleTensor res2 = plans.decryptDecode(c2);
+    HELAYERS_TIMER_POP();
+
+    images.assertEquals(res1, "TTEncoder", 1e-3);
+    images.assertEquals(res2, "PackingPlan", 1e-3);
+    // Both produce the same layout.
+    enc.assertEquals(c2, "PackingPlan layout", images, 1e-3);
+  }
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("TTEncoder");
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("PackingPlan");
+
+  // The plan was built once and reused.
+  always_assert(plans.size() == 1);
+
+  cout << "\nPacking plans worked correctly!" << endl;
+}
@@ -0,0 +1,119 @@
+//
+//  tut_20_encoding_pipeline.cpp
+//  HELayers-Tutorials
+//
+
+#include "HELayers-Tutorials-Bridging-Header.h"
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "helayers/math/TTEncoder.h"
+#include "EncodingPipeline.h"
+
+// This tutorial shows how to hide the encoding time of lazily encoded
+// weights.
+// With LAZY_ENCODING, weights are kept as raw values and encoded by
+// wakeup() only when needed, which saves memory but puts the encoding on
+// the critical path. An EncodingPipeline wakes up the weights of the next
+// layers on background threads while the current layer computes, and puts
+// used layers back to sleep, so only a few layers are encoded at a time.
+
+using namespace std;
+using namespace helayers;
+
+void tut_20_run(HeContext& he);
+
+void tut_20_encoding_pipeline()
+{
+  // As in tut_1_basics, let's choose the same HE CKKS setup
+  HeConfigRequirement requirement;
+  requirement.numSlots = 4096;
+  requirement.multiplicationDepth = 2;
+  requirement.fractionalPartPrecision = 40;
+  requirement.integerPartPrecision = 20;
+  requirement.securityLevel = 128;
+  shared_ptr<HeContext> hePtr = make_shared<SealCkksContext>();
+  hePtr->init(requirement);
+
+  // Let's also make sure we have enough security
+  always_assert(hePtr->getSecurityLevel() >= 128);
+
+  // and do some work
+  tut_20_run(*hePtr);
+}
+
+// Our model has 6 layers. Layers 0 and 3 multiply by their weights, and the
+// others add their weights.
+bool isMultiplyLayer(int l) { return l % 3 == 0; }
+
+void tut_20_run(HeContext& he)
+{
+  const int numLayers = 6;
+  TTShape shape({64, 64});
+  shape.setOriginalSizes({256, 256});
+  TTEncoder enc(he);
+  TTEncoder lazyEnc(he, LAZY_ENCODING);
+
+  DoubleTensor input({256, 256});
+  input.initRandom(-1, 1);
+  DoubleTensor expected(input);
+  vector<DoubleTensor> weights;
+  for (int l = 0; l < numLayers; ++l) {
+    weights.emplace_back(vector<DimInt>{256, 256});
+    weights.back().initRandom(-1, 1);
+    if (isMultiplyLayer(l))
+      expected.elementMultiply(weights.back());
+    else
+      expected.elementAdd(weights.back());
+  }
+
+  // The chain index each layer's weights are used at.
+  vector<int> chainIndexes;
+  int ci = he.getTopChainIndex();
+  for (int l = 0; l < numLayers; ++l) {
+    chainIndexes.push_back(ci);
+    if (isMultiplyLayer(l))
+      --ci;
+  }
+
+  for (bool pipelined : {false, true}) {
+    vector<PTileTensor> layers(numLayers, PTileTensor(he));
+    for (int l = 0; l < numLayers; ++l) {
+      lazyEnc.encode(layers[l], shape, weights[l]);
+      layers[l].sleep();
+    }
+    CTileTensor x(he);
+    enc.encodeEncrypt(x, shape, input);
+
+    string title = pipelined ? "pipelined" : "synchronous";
+    HELAYERS_TIMER_PUSH(title);
+    EncodingPipeline pipeline(2);
+    if (pipelined) {
+      for (int l = 0; l < numLayers; ++l)
+        pipeline.addStage(layers[l], chainIndexes[l]);
+      pipeline.start();
+    }
+    for (int l = 0; l < numLayers; ++l) {
+      if (!pipelined) {
+        layers[l].setLazyChainIndex(chainIndexes[l]);
+        layers[l].wakeup();
+      }
+      const PTileTensor& w = pipelined ? pipeline.acquire(l) : layers[l];
+      if (isMultiplyLayer(l))
+        x.multiplyPlain(w);
+      else
+        x.addPlain(w);
+      if (pipelined)
+        pipeline.release(l);
+      else
+        layers[l].sleep();
+    }
+    HELAYERS_TIMER_POP();
+
+    enc.assertEquals(x, title, expected, 1e-2);
+  }
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("synchronous");
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("pipelined");
+
+  cout << "\nEncoding pipeline worked correctly!" << endl;
+}
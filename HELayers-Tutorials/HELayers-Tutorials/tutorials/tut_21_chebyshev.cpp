@@ -0,0 +1,99 @@
+//
+//  tut_21_chebyshev.cpp
+//  HELayers-Tutorials
+//
+
+#include "HELayers-Tutorials-Bridging-Header.h"
+
+#include <cmath>
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "helayers/math/TTEncoder.h"
+#include "ChebyshevEvaluator.h"
+
+// This tutorial shows how to evaluate high degree polynomial approximations
+// of activation functions.
+// In the power basis, high degree approximations have huge coefficients of
+// alternating signs, and precision is lost. In the Chebyshev basis they
+// stay well conditioned. The ChebyshevEvaluator evaluates such polynomials
+// with the Paterson-Stockmeyer algorithm, so a degree 63 polynomial takes
+// 16 ciphertext multiplications instead of about 60, and only 7 levels.
+
+using namespace std;
+using namespace helayers;
+
+void tut_21_run(HeContext& he);
+
+void tut_21_chebyshev()
+{
+  // We need a deeper circuit than in tut_1_basics, so we use more levels and
+  // more slots.
+  HeConfigRequirement requirement;
+  requirement.numSlots = 8192;
+  requirement.multiplicationDepth = 7;
+  requirement.fractionalPartPrecision = 40;
+  requirement.integerPartPrecision = 20;
+  requirement.securityLevel = 128;
+  shared_ptr<HeContext> hePtr = make_shared<SealCkksContext>();
+  hePtr->init(requirement);
+
+  // Let's also make sure we have enough security
+  always_assert(hePtr->getSecurityLevel() >= 128);
+
+  // and do some work
+  tut_21_run(*hePtr);
+}
+
+void tut_21_run(HeContext& he)
+{
+  Encoder encoder(he);
+  ChebyshevEvaluator ce(he);
+  int n = he.slotCount();
+
+  // tanh(4x) on [-1, 1], with a degree 63 approximation.
+  auto f = [](double x) { return tanh(4 * x); };
+  vector<double> coefs = ChebyshevEvaluator::interpolate(f, 63);
+  vector<double> vals(n), expected(n);
+  for (int i = 0; i < n; ++i) {
+    vals[i] = -1 + 2.0 * i / (n - 1);
+    expected[i] = f(vals[i]);
+    always_assert(fabs(ChebyshevEvaluator::evalPlain(coefs, vals[i]) -
+                       expected[i]) < 1e-4);
+  }
+  CTile x(he);
+  encoder.encodeEncrypt(x, vals);
+
+  HELAYERS_TIMER_PUSH("chebyshev");
+  CTile res = ce.evaluate(x, coefs);
+  HELAYERS_TIMER_POP();
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("chebyshev");
+  cout << "Degree 63: " << ce.getNumMultiplications()
+       << " ciphertext multiplications, depth "
+       << x.getChainIndex() - res.getChainIndex() << endl;
+  always_assert(x.getChainIndex() - res.getChainIndex() ==
+                ChebyshevEvaluator::getMulDepth(63));
+  always_assert(ce.getNumMultiplications() ==
+                ChebyshevEvaluator::getMaxNumMultiplications(63));
+  encoder.assertEquals(res, "tanh", expected, 1e-3);
+
+  // A sigmoid on the wider interval [-8, 8], applied to a tile tensor. The
+  // input is mapped to [-1, 1] first, at the cost of one more level.
+  auto sigmoid = [](double x) { return 1 / (1 + exp(-x)); };
+  vector<double> sigCoefs = ChebyshevEvaluator::interpolate(sigmoid, 31, -8, 8);
+  TTEncoder enc(he);
+  TTShape shape({64, 128});
+  shape.setOriginalSizes({100, 200});
+  DoubleTensor t({100, 200});
+  t.initRandom(-8, 8);
+  CTileTensor tC(he);
+  enc.encodeEncrypt(tC, shape, t);
+  CTileTensor sigRes = ce.evaluate(tC, sigCoefs, -8, 8);
+  DoubleTensor sigExpected(t);
+  for (DimInt i = 0; i < 100; ++i)
+    for (DimInt j = 0; j < 200; ++j)
+      sigExpected.at(i, j) = sigmoid(t.at(i, j));
+  enc.assertEquals(sigRes, "sigmoid", sigExpected, 1e-3);
+
+  cout << "\nChebyshev evaluation worked correctly!" << endl;
+}
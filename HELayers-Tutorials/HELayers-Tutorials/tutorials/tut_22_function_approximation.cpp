@@ -0,0 +1,126 @@
+//
+//  tut_22_function_approximation.cpp
+//  HELayers-Tutorials
+//
+
+#include "HELayers-Tutorials-Bridging-Header.h"
+
+#include <cmath>
+#include <filesystem>
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "FunctionApproximator.h"
+
+// This tutorial shows how to approximate arbitrary functions under
+// encryption, given only the function, its input range and the required
+// precision.
+// A FunctionApproximator fits a minimax polynomial of the lowest degree that
+// meets the error bound, and picks the evaluation algorithm with the fewest
+// estimated multiplications among those that fit in the available depth.
+// Fitting takes a while for high degrees, so compiled plans are cached, in
+// memory and on disk.
+
+using namespace std;
+using namespace helayers;
+
+void tut_22_run(HeContext& he, const string& cacheDir);
+
+void tut_22_function_approximation()
+{
+  // We need a deeper circuit than in tut_1_basics, so we use more levels and
+  // more slots.
+  HeConfigRequirement requirement;
+  requirement.numSlots = 8192;
+  requirement.multiplicationDepth = 7;
+  requirement.fractionalPartPrecision = 40;
+  requirement.integerPartPrecision = 20;
+  requirement.securityLevel = 128;
+  shared_ptr<HeContext> hePtr = make_shared<SealCkksContext>();
+  hePtr->init(requirement);
+
+  // Let's also make sure we have enough security
+  always_assert(hePtr->getSecurityLevel() >= 128);
+
+  // Plans are cached on disk in a scratch directory, like the app's caches
+  // directory, so they survive between runs but not app reinstalls.
+  string cacheDir =
+      (filesystem::temp_directory_path() / "helayers_approximations").string();
+
+  // and do some work
+  tut_22_run(*hePtr, cacheDir);
+}
+
+void checkApproximation(HeContext& he,
+                        FunctionApproximator& approximator,
+                        const string& name,
+                        const function<double(double)>& f,
+                        double a,
+                        double b,
+                        double maxError)
+{
+  ApproximationPlan plan = approximator.compile(name, f, a, b, maxError);
+  plan.debugPrint(name);
+  always_assert(plan.maxError <= maxError);
+
+  Encoder encoder(he);
+  int n = he.slotCount();
+  vector<double> vals(n), expected(n);
+  for (int i = 0; i < n; ++i) {
+    vals[i] = a + (b - a) * i / (n - 1);
+    expected[i] = f(vals[i]);
+  }
+  CTile x(he);
+  encoder.encodeEncrypt(x, vals);
+  CTile res = approximator.evaluate(x, plan);
+  always_assert(x.getChainIndex() - res.getChainIndex() <= plan.depth);
+  // Allow for the CKKS noise on top of the approximation error.
+  encoder.assertEquals(res, name, expected, maxError + 1e-4);
+}
+
+void tut_22_run(HeContext& he, const string& cacheDir)
+{
+  // Plans are also saved under cacheDir, and loaded from there on later runs.
+  FunctionApproximator approximator(he, cacheDir);
+
+  // A low precision sigmoid needs only a low degree, and may be evaluated in
+  // the power basis.
+  checkApproximation(
+      he, approximator, "sigmoid",
+      [](double x) { return 1 / (1 + exp(-x)); }, -8, 8, 1e-2);
+
+  // A high precision one needs a high degree, where only the Chebyshev basis
+  // is stable.
+  checkApproximation(
+      he, approximator, "sigmoid",
+      [](double x) { return 1 / (1 + exp(-x)); }, -8, 8, 1e-4);
+
+  // GELU, as used in transformers.
+  checkApproximation(
+      he, approximator, "gelu",
+      [](double x) { return x / 2 * (1 + erf(x / sqrt(2))); }, -6, 6, 1e-3);
+
+  // The second compilation of the same function is served from the cache.
+  HELAYERS_TIMER_PUSH("cached compile");
+  approximator.compile(
+      "gelu", [](double x) { return x / 2 * (1 + erf(x / sqrt(2))); }, -6, 6,
+      1e-3);
+  HELAYERS_TIMER_POP();
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("cached compile");
+
+  // A new approximator, as in a later run of the app, has an empty memory
+  // cache, and loads the plan from disk instead of fitting it again.
+  auto gelu = [](double x) { return x / 2 * (1 + erf(x / sqrt(2))); };
+  ApproximationPlan plan = approximator.compile("gelu", gelu, -6, 6, 1e-3);
+  FunctionApproximator reloader(he, cacheDir);
+  HELAYERS_TIMER_PUSH("compile from disk");
+  ApproximationPlan reloaded = reloader.compile("gelu", gelu, -6, 6, 1e-3);
+  HELAYERS_TIMER_POP();
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("compile from disk");
+  always_assert(reloaded.method == plan.method &&
+                reloaded.degree == plan.degree &&
+                reloaded.chebyshevCoefs == plan.chebyshevCoefs &&
+                reloaded.powerCoefs == plan.powerCoefs);
+
+  cout << "\nFunction approximation worked correctly!" << endl;
+}
@@ -0,0 +1,94 @@
+//
+//  tut_23_sign_tuning.cpp
+//  HELayers-Tutorials
+//
+
+#include "HELayers-Tutorials-Bridging-Header.h"
+
+#include <cmath>
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "SignTuner.h"
+
+// This tutorial shows how to choose the parameters of encrypted comparisons
+// by the precision required.
+// Comparisons are computed with a composite polynomial approximation of
+// sign, and its depth depends on how close the compared values may be and
+// how precise the result must be. A SignTuner finds the cheapest composition
+// for a given minimal gap and precision, and reports its depth and cost
+// before anything is evaluated.
+
+using namespace std;
+using namespace helayers;
+
+void tut_23_run(HeContext& he);
+
+void tut_23_sign_tuning()
+{
+  // Comparisons are deep, so we need many more levels than in tut_1_basics.
+  HeConfigRequirement requirement;
+  requirement.numSlots = 16384;
+  requirement.multiplicationDepth = 16;
+  requirement.fractionalPartPrecision = 40;
+  requirement.integerPartPrecision = 20;
+  requirement.securityLevel = 128;
+  shared_ptr<HeContext> hePtr = make_shared<SealCkksContext>();
+  hePtr->init(requirement);
+
+  // Let's also make sure we have enough security
+  always_assert(hePtr->getSecurityLevel() >= 128);
+
+  // and do some work
+  tut_23_run(*hePtr);
+}
+
+void tut_23_run(HeContext& he)
+{
+  // The cost grows with the precision, and more so as the gap shrinks.
+  for (double gap : {0.1, 0.01, 0.001})
+    for (double precision : {1e-2, 1e-4})
+      SignTuner::tune(precision, gap)
+          .debugPrint("gap " + to_string(gap) + ", precision " +
+                      to_string(precision));
+
+  // Values in [0, 100], compared when they differ by at least 10. The
+  // difference is in [-100, 100].
+  Encoder encoder(he);
+  SignTuner tuner(he);
+  int n = he.slotCount();
+  vector<double> a(n), b(n);
+  for (int i = 0; i < n; ++i) {
+    a[i] = (i * 37) % 11 * 10;
+    b[i] = (i * 53) % 11 * 10;
+  }
+  CTile aC(he), bC(he);
+  encoder.encodeEncrypt(aC, a);
+  encoder.encodeEncrypt(bC, b);
+
+  // min() takes two levels more than its plan.
+  int maxDepth = he.getTopChainIndex() - 2;
+  SignPlan comparePlan = SignTuner::tune(1e-2, 10, 100, true, maxDepth);
+  comparePlan.debugPrint("compare");
+  SignPlan minPlan = SignTuner::tune(1e-3, 10, 100, false, maxDepth);
+  minPlan.debugPrint("min");
+
+  CTile greater = tuner.compare(aC, bC, comparePlan);
+  always_assert(aC.getChainIndex() - greater.getChainIndex() <=
+                comparePlan.depth);
+  CTile minC = tuner.min(aC, bC, minPlan);
+
+  // Equal values aren't at least 10 apart, so their comparison result is
+  // 0.5 rather than 0 or 1.
+  vector<double> expectedGreater(n), expectedMin(n);
+  for (int i = 0; i < n; ++i) {
+    expectedGreater[i] = a[i] > b[i] ? 1 : a[i] < b[i] ? 0 : 0.5;
+    expectedMin[i] = std::min(a[i], b[i]);
+  }
+  // Allow for the CKKS noise on top of the approximation error.
+  encoder.assertEquals(greater, "compare", expectedGreater, 1e-2 + 1e-4);
+  // The error of |a - b|, noise included, is relative to its range.
+  encoder.assertEquals(minC, "min", expectedMin, 100 * (1e-3 + 1e-4));
+
+  cout << "\nSign tuning worked correctly!" << endl;
+}
@@ -0,0 +1,99 @@
+//
+//  tut_24_batched_poly_eval.cpp
+//  HELayers-Tutorials
+//
+
+#include "HELayers-Tutorials-Bridging-Header.h"
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "helayers/math/TTEncoder.h"
+#include "helayers/math/TTFunctionEvaluator.h"
+#include "BatchedPolyEvaluator.h"
+
+// This tutorial shows how to evaluate a polynomial on a large tensor.
+// Activations apply the same polynomial to every tile of a tensor. A
+// BatchedPolyEvaluator plans the evaluation and encodes the coefficients
+// once, evaluates the tiles in parallel with reused scratch tiles, and sums
+// the terms of each tile before a single rescale.
+
+using namespace std;
+using namespace helayers;
+
+void tut_24_run(HeContext& he);
+
+void tut_24_batched_poly_eval()
+{
+  // We use a slightly deeper setup than in tut_1_basics, for a degree 7
+  // polynomial.
+  HeConfigRequirement requirement;
+  requirement.numSlots = 4096;
+  requirement.multiplicationDepth = 4;
+  requirement.fractionalPartPrecision = 40;
+  requirement.integerPartPrecision = 20;
+  requirement.securityLevel = 128;
+  shared_ptr<HeContext> hePtr = make_shared<SealCkksContext>();
+  hePtr->init(requirement);
+
+  // Let's also make sure we have enough security
+  always_assert(hePtr->getSecurityLevel() >= 128);
+
+  // and do some work
+  tut_24_run(*hePtr);
+}
+
+void tut_24_run(HeContext& he)
+{
+  TTEncoder enc(he);
+
+  // A 640x640 tensor in 64x64 tiles: 100 tiles.
+  TTShape shape({64, 64});
+  shape.setOriginalSizes({640, 640});
+  DoubleTensor t({640, 640});
+  t.initRandom(-1, 1);
+  CTileTensor src(he);
+  enc.encodeEncrypt(src, shape, t);
+
+  // A degree 7 polynomial.
+  vector<double> coefs = {0.5, 0.2, 0, -0.01, 0, 0.001, 0, -0.0001};
+  DoubleTensor expected(t);
+  for (DimInt i = 0; i < 640; ++i)
+    for (DimInt j = 0; j < 640; ++j) {
+      double x = t.at(i, j), res = 0;
+      for (int k = (int)coefs.size() - 1; k >= 0; --k)
+        res = res * x + coefs[k];
+      expected.at(i, j) = res;
+    }
+
+  TTFunctionEvaluator tfe(he);
+  CTileTensor perTile(src);
+  HELAYERS_TIMER_PUSH("per tile");
+  tfe.polyEvalInPlace(perTile, coefs);
+  HELAYERS_TIMER_POP();
+
+  BatchedPolyEvaluator bpe(he, coefs);
+  cout << "Depth " << bpe.getMulDepth() << ", "
+       << bpe.getNumMultiplications() << " multiplications per tile" << endl;
+  HELAYERS_TIMER_PUSH("batched, 1 thread");
+  CTileTensor serial = bpe.eval(src, 1);
+  HELAYERS_TIMER_POP();
+  HELAYERS_TIMER_PUSH("batched");
+  CTileTensor batched = bpe.eval(src);
+  HELAYERS_TIMER_POP();
+
+  // The tiles are independent, so the batched evaluation speeds up with the
+  // number of cores.
+  cout << "Batched evaluation on " << getNumWorkers(src.getNumUsedTiles())
+       << " threads" << endl;
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("per tile");
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("batched, 1 thread");
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("batched");
+  enc.assertEquals(perTile, "per tile", expected, 1e-3);
+  enc.assertEquals(serial, "batched, 1 thread", expected, 1e-3);
+  enc.assertEquals(batched, "batched", expected, 1e-3);
+  always_assert(src.getTileByFlatIndex(0).getChainIndex() -
+                    batched.getTileByFlatIndex(0).getChainIndex() ==
+                bpe.getMulDepth());
+
+  cout << "\nBatched polynomial evaluation worked correctly!" << endl;
+}
@@ -0,0 +1,142 @@
+//
+//  tut_25_tournament.cpp
+//  HELayers-Tutorials
+//
+
+#include "HELayers-Tutorials-Bridging-Header.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "helayers/math/TTEncoder.h"
+#include "TournamentEvaluator.h"
+
+// This tutorial shows how to find the maximum of encrypted values, and where
+// it is.
+// Comparing the values one after the other takes n - 1 sequential
+// comparisons, each many levels deep. A tournament compares all the values
+// in pairs at once, with one SIMD comparison per round, and takes only
+// log2(n) rounds. Here we classify a batch of samples into 4 classes, e.g.,
+// the outputs of an encrypted model, with the scores of each sample along
+// the first dimension of a tile tensor.
+
+using namespace std;
+using namespace helayers;
+
+void tut_25_run(HeContext& he);
+
+void tut_25_tournament()
+{
+  // Each tournament round is a sign polynomial and a multiplication, and
+  // argmax adds an indicator comparison on top of the rounds, so 4 classes
+  // need many more levels than in tut_1_basics. The scores are small integers
+  // whose max stands 1 above the rest, so 25 bits of scale resolve them.
+  HeConfigRequirement requirement;
+  requirement.numSlots = 16384;
+  requirement.multiplicationDepth = 30;
+  requirement.fractionalPartPrecision = 25;
+  requirement.integerPartPrecision = 10;
+  requirement.securityLevel = 128;
+  shared_ptr<HeContext> hePtr = make_shared<SealCkksContext>();
+  hePtr->init(requirement);
+
+  // Let's also make sure we have enough security
+  always_assert(hePtr->getSecurityLevel() >= 128);
+
+  // and do some work
+  tut_25_run(*hePtr);
+}
+
+void tut_25_run(HeContext& he)
+{
+  const int numClasses = 4, numSamples = 8192;
+  // The scores are in [0, 3] and the top score is at least 1 above the
+  // others.
+  TournamentEvaluator te(he, 0, 3, 1, 1e-2);
+  cout << "max depth " << te.getMaxDepth(numClasses) << ", argmax depth "
+       << te.getArgmaxDepth(numClasses) << endl;
+  always_assert(te.getArgmaxDepth(numClasses) <= he.getTopChainIndex());
+
+  // Each sample's scores are a permutation of 0..3.
+  DoubleTensor scores({numClasses, numSamples});
+  DoubleTensor expectedMax({1, numSamples});
+  DoubleTensor expectedArgmax({numClasses, numSamples});
+  for (DimInt s = 0; s < numSamples; ++s) {
+    vector<int> perm = {0, 1, 2, 3};
+    rotate(perm.begin(), perm.begin() + s % 4, perm.end());
+    if (s % 3 == 0)
+      swap(perm[0], perm[2]);
+    for (DimInt c = 0; c < numClasses; ++c) {
+      scores.at(c, s) = perm[c];
+      expectedArgmax.at(c, s) = perm[c] == 3 ? 1 : 0;
+    }
+    expectedMax.at(0, s) = 3;
+  }
+
+  // Two tiles along the classes, so the tournament takes one round over
+  // tiles and one inside them.
+  TTEncoder enc(he);
+  TTShape shape({2, numSamples});
+  shape.setOriginalSizes({numClasses, numSamples});
+  CTileTensor c(he);
+  enc.encodeEncrypt(c, shape, scores);
+
+  HELAYERS_TIMER_PUSH("maxOverDim");
+  CTileTensor maxC = te.maxOverDim(c, 0);
+  HELAYERS_TIMER_POP();
+  HELAYERS_TIMER_PUSH("argmaxOverDim");
+  CTileTensor argmaxC = te.argmaxOverDim(c, 0);
+  HELAYERS_TIMER_POP();
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("maxOverDim");
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("argmaxOverDim");
+  enc.assertEquals(maxC, "max", expectedMax, 0.1);
+  enc.assertEquals(argmaxC, "argmax", expectedArgmax, 0.05);
+
+  // The min is the max of the negated scores. Every sample's lowest score
+  // is 0, at least 1 below the others.
+  DoubleTensor expectedMin({1, numSamples});
+  enc.assertEquals(te.minOverDim(c, 0), "min", expectedMin, 0.1);
+
+  // The same for a single vector of scores in a CTile.
+  Encoder encoder(he);
+  CTile v(he);
+  encoder.encodeEncrypt(v, vector<double>{2, 0, 3, 1});
+  encoder.assertEquals(
+      te.max(v, numClasses), "max", vector<double>(he.slotCount(), 3), 0.1);
+  encoder.assertEquals(
+      te.min(v, numClasses), "min", vector<double>(he.slotCount(), 0), 0.1);
+  CTile ind = te.argmax(v, numClasses);
+  vector<double> indVals = encoder.decryptDecodeDouble(ind);
+  vector<double> expectedInd = {0, 0, 1, 0};
+  for (int i = 0; i < numClasses; ++i)
+    always_assert(fabs(indVals[i] - expectedInd[i]) < 0.05);
+
+  // With a positive lower bound the values are compared shifted by it, so
+  // the zeros in the unused slots stay within the comparisons' bounds too.
+  // Here the scores are in [10, 13].
+  TournamentEvaluator shiftedTe(he, 10, 13, 1, 1e-2);
+  always_assert(shiftedTe.getArgmaxDepth(numClasses) <= he.getTopChainIndex());
+  CTileTensor shiftedC(c);
+  shiftedC.addScalar(10, true);
+  DoubleTensor shiftedMax(expectedMax);
+  shiftedMax.addScalar(10);
+  enc.assertEquals(
+      shiftedTe.maxOverDim(shiftedC, 0), "shifted max", shiftedMax, 0.1);
+  DoubleTensor shiftedMin(expectedMin);
+  shiftedMin.addScalar(10);
+  enc.assertEquals(
+      shiftedTe.minOverDim(shiftedC, 0), "shifted min", shiftedMin, 0.1);
+  enc.assertEquals(shiftedTe.argmaxOverDim(shiftedC, 0),
+                   "shifted argmax",
+                   expectedArgmax,
+                   0.05);
+  CTile w(he);
+  encoder.encodeEncrypt(w, vector<double>{12, 10, 13, 11});
+  indVals = encoder.decryptDecodeDouble(shiftedTe.argmax(w, numClasses));
+  for (int i = 0; i < numClasses; ++i)
+    always_assert(fabs(indVals[i] - expectedInd[i]) < 0.05);
+
+  cout << "\nTournament worked correctly!" << endl;
+}
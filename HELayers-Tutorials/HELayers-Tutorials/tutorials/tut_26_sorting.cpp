@@ -0,0 +1,125 @@
+//
+//  tut_26_sorting.cpp
+//  HELayers-Tutorials
+//
+
+#include "HELayers-Tutorials-Bridging-Header.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "helayers/math/TTEncoder.h"
+#include "SortingNetwork.h"
+
+// This tutorial shows how to sort encrypted values.
+// A bitonic sorting network is a fixed sequence of stages, each comparing
+// pairs of positions a fixed distance apart. A SortingNetwork computes all
+// the comparators of a stage with one SIMD comparison against a rotated
+// copy, and sorts many vectors at once when they lie side by side in the
+// slots. When only the top k values are needed, it stops sorting the rest
+// early.
+
+using namespace std;
+using namespace helayers;
+
+void tut_26_run(HeContext& he);
+
+void tut_26_sorting()
+{
+  // A bitonic sort of 4 values takes 3 stages, each a comparison polynomial
+  // and a multiplication deep, so we need many more levels than in
+  // tut_1_basics. The values are small integers, at least 1 apart, so 25
+  // bits of scale resolve them.
+  HeConfigRequirement requirement;
+  requirement.numSlots = 16384;
+  requirement.multiplicationDepth = 30;
+  requirement.fractionalPartPrecision = 25;
+  requirement.integerPartPrecision = 10;
+  requirement.securityLevel = 128;
+  shared_ptr<HeContext> hePtr = make_shared<SealCkksContext>();
+  hePtr->init(requirement);
+
+  // Let's also make sure we have enough security
+  always_assert(hePtr->getSecurityLevel() >= 128);
+
+  // and do some work
+  tut_26_run(*hePtr);
+}
+
+void tut_26_run(HeContext& he)
+{
+  // The number of stages, and so the depth, grows with log2(n)^2 for a full
+  // sort, but only with log2(n) for the top k. Deep networks need
+  // bootstrapping.
+  for (int n : {16, 256, 4096})
+    cout << "n = " << n << ": sort " << SortingNetwork::getNumSortStages(n)
+         << " stages, top 4 " << SortingNetwork::getNumTopKStages(n, 4)
+         << " stages" << endl;
+
+  // Values in [0, 3], at least 1 apart.
+  SortingNetwork sn(he, 0, 3, 1, 1e-2);
+  always_assert(sn.getDepth(SortingNetwork::getNumSortStages(4)) <=
+                he.getTopChainIndex());
+
+  // Sort 4096 vectors of 4 values each, one per column of a 4x4096 matrix.
+  const int n = 4, numVectors = 4096;
+  DoubleTensor vals({n, numVectors});
+  DoubleTensor expected({n, numVectors});
+  for (DimInt v = 0; v < numVectors; ++v) {
+    vector<double> col = {0, 1, 2, 3};
+    rotate(col.begin(), col.begin() + v % 4, col.end());
+    if (v % 3 == 0)
+      swap(col[1], col[3]);
+    for (DimInt i = 0; i < n; ++i)
+      vals.at(i, v) = col[i];
+    sort(col.begin(), col.end(), greater<double>());
+    for (DimInt i = 0; i < n; ++i)
+      expected.at(i, v) = col[i];
+  }
+  TTEncoder enc(he);
+  TTShape shape({n, numVectors});
+  CTileTensor c(he);
+  enc.encodeEncrypt(c, shape, vals);
+
+  HELAYERS_TIMER_PUSH("sortOverDim");
+  CTileTensor sorted = sn.sortOverDim(c, 0, true);
+  HELAYERS_TIMER_POP();
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("sortOverDim");
+  enc.assertEquals(sorted, "sortOverDim", expected, 0.1);
+
+  // With 3 values per vector, each vector leaves an unused slot holding 0
+  // in its tile. An ascending sort must still keep these zeros out of the
+  // used positions.
+  const int padded = 3;
+  DoubleTensor paddedVals({padded, numVectors});
+  DoubleTensor paddedExpected({padded, numVectors});
+  for (DimInt v = 0; v < numVectors; ++v) {
+    vector<double> col = {1, 2, 3};
+    rotate(col.begin(), col.begin() + v % 3, col.end());
+    for (DimInt i = 0; i < padded; ++i) {
+      paddedVals.at(i, v) = col[i];
+      paddedExpected.at(i, v) = i + 1;
+    }
+  }
+  TTShape paddedShape({n, numVectors});
+  paddedShape.setOriginalSizes({padded, numVectors});
+  CTileTensor paddedC(he);
+  enc.encodeEncrypt(paddedC, paddedShape, paddedVals);
+  enc.assertEquals(sn.sortOverDim(paddedC, 0, false),
+                   "padded ascending sortOverDim",
+                   paddedExpected,
+                   0.1);
+
+  // The top 2 of a single vector.
+  Encoder encoder(he);
+  CTile v(he);
+  encoder.encodeEncrypt(v, vector<double>{1, 3, 0, 2});
+  vector<double> top = encoder.decryptDecodeDouble(sn.topK(v, n, 2));
+  always_assert(fabs(top[0] - 3) < 0.1 && fabs(top[1] - 2) < 0.1);
+  encoder.assertEquals(
+      sn.sort(v, n), "sort", vector<double>{0, 1, 2, 3}, 0.1);
+
+  cout << "\nSorting worked correctly!" << endl;
+}
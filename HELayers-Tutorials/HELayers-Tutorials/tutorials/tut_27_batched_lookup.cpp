@@ -0,0 +1,95 @@
+//
+//  tut_27_batched_lookup.cpp
+//  HELayers-Tutorials
+//
+
+#include "HELayers-Tutorials-Bridging-Header.h"
+
+#include <cmath>
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "helayers/math/TTEncoder.h"
+#include "BatchedKeyLookup.h"
+
+// This tutorial shows how to look up many encrypted keys in an encrypted
+// table at once.
+// Comparing each query key with the key column separately repeats the
+// per-bit work for every query, and fills only one dimension of the slots.
+// Here the records lie along the first dimension of a tile tensor and the
+// queries along the second, so each bit is compared for all the
+// (record, query) pairs with a handful of SIMD operations. The result is a
+// selection mask, which we then use to fetch a value for every query.
+
+using namespace std;
+using namespace helayers;
+
+void tut_27_run(HeContext& he);
+
+void tut_27_batched_lookup()
+{
+  // 8-bit keys take 4 levels to compare, and the lookup one more.
+  HeConfigRequirement requirement;
+  requirement.numSlots = 8192;
+  requirement.multiplicationDepth = 5;
+  requirement.fractionalPartPrecision = 40;
+  requirement.integerPartPrecision = 20;
+  requirement.securityLevel = 128;
+  shared_ptr<HeContext> hePtr = make_shared<SealCkksContext>();
+  hePtr->init(requirement);
+
+  // Let's also make sure we have enough security
+  always_assert(hePtr->getSecurityLevel() >= 128);
+
+  // and do some work
+  tut_27_run(*hePtr);
+}
+
+void tut_27_run(HeContext& he)
+{
+  const int numBits = 8, numRecords = 100, numQueries = 128;
+  // 64x128 tiles fill all 8192 slots. The records take two tiles.
+  BatchedKeyLookup lookup(he, numBits, {64, 128});
+  cout << "equality depth " << lookup.getMulDepth() << endl;
+  always_assert(lookup.getMulDepth() + 1 <= he.getTopChainIndex());
+
+  // Distinct record keys, and a value for each record.
+  vector<int> recordKeys(numRecords);
+  DoubleTensor values({numRecords, 1});
+  for (int r = 0; r < numRecords; ++r) {
+    recordKeys[r] = (r * 37 + 11) % 256;
+    values.at(r, 0) = r / 10.0;
+  }
+  // Half of the queries hit a record, and the rest miss.
+  vector<int> queryKeys(numQueries);
+  DoubleTensor expectedMask({numRecords, numQueries});
+  DoubleTensor expectedValues({1, numQueries});
+  for (int q = 0; q < numQueries; ++q) {
+    queryKeys[q] = q % 2 == 0 ? recordKeys[(q * 7) % numRecords]
+                              : (q * 53) % 256;
+    for (int r = 0; r < numRecords; ++r)
+      if (recordKeys[r] == queryKeys[q]) {
+        expectedMask.at(r, q) = 1;
+        expectedValues.at(0, q) = values.at(r, 0);
+      }
+  }
+
+  vector<CTileTensor> recordBits = lookup.encryptRecordKeys(recordKeys);
+  vector<CTileTensor> queryBits = lookup.encryptQueryKeys(queryKeys);
+  TTEncoder enc(he);
+  CTileTensor valuesC(he);
+  enc.encodeEncrypt(valuesC, lookup.getRecordShape(numRecords), values);
+
+  HELAYERS_TIMER_PUSH("isEqual");
+  CTileTensor mask = lookup.isEqual(recordBits, queryBits);
+  HELAYERS_TIMER_POP();
+  HELAYERS_TIMER_PUSH("lookup");
+  CTileTensor res = lookup.lookup(mask, valuesC);
+  HELAYERS_TIMER_POP();
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("isEqual");
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("lookup");
+  enc.assertEquals(mask, "mask", expectedMask, 1e-3);
+  enc.assertEquals(res, "values", expectedValues, 1e-2);
+
+  cout << "\nBatched lookup worked correctly!" << endl;
+}
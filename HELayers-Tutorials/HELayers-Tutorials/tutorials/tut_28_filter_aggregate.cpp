@@ -0,0 +1,101 @@
+//
+//  tut_28_filter_aggregate.cpp
+//  HELayers-Tutorials
+//
+
+#include "HELayers-Tutorials-Bridging-Header.h"
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "helayers/math/TTEncoder.h"
+#include "FilterAggregator.h"
+
+// This tutorial shows how to compute SQL-like aggregates over an encrypted
+// table: SUM and COUNT of the rows whose encrypted key equals a given key,
+// and the same for every key at once, as in GROUP BY.
+// Building an equality mask over all the rows, multiplying it into the
+// values and summing it by hand repeats the comparison for each aggregate
+// and each key, and keeps a full-size mask around. FilterAggregator shares
+// the comparison work among the keys and aggregates each tile of rows on
+// its own.
+
+using namespace std;
+using namespace helayers;
+
+void tut_28_run(HeContext& he);
+
+void tut_28_filter_aggregate()
+{
+  // 4-bit keys take 2 levels to compare, and the aggregation one more.
+  HeConfigRequirement requirement;
+  requirement.numSlots = 8192;
+  requirement.multiplicationDepth = 3;
+  requirement.fractionalPartPrecision = 40;
+  requirement.integerPartPrecision = 20;
+  requirement.securityLevel = 128;
+  shared_ptr<HeContext> hePtr = make_shared<SealCkksContext>();
+  hePtr->init(requirement);
+
+  // Let's also make sure we have enough security
+  always_assert(hePtr->getSecurityLevel() >= 128);
+
+  // and do some work
+  tut_28_run(*hePtr);
+}
+
+void tut_28_run(HeContext& he)
+{
+  // A table of sales, each with one of 16 regions and an amount. The rows
+  // take two tiles, the second partly used.
+  const int numBits = 4, numRegions = 16, numRows = 10000;
+  FilterAggregator agg(he, numBits);
+  cout << "depth " << agg.getDepth() << endl;
+  always_assert(agg.getDepth() <= he.getTopChainIndex());
+
+  vector<int> regions(numRows);
+  DoubleTensor amounts({numRows});
+  amounts.initRandom(0, 10);
+  vector<double> expectedSums(numRegions, 0), expectedCounts(numRegions, 0);
+  for (int r = 0; r < numRows; ++r) {
+    regions[r] = (r * 7 + r / 3) % numRegions;
+    expectedSums[regions[r]] += amounts.at(r);
+    expectedCounts[regions[r]] += 1;
+  }
+
+  vector<CTileTensor> regionBits = agg.encryptKeys(regions);
+  TTEncoder enc(he);
+  CTileTensor amountsC(he);
+  enc.encodeEncrypt(amountsC, agg.getShape(numRows), amounts);
+
+  // SELECT SUM(amount), COUNT(*) WHERE region = 5
+  Encoder encoder(he);
+  HELAYERS_TIMER_PUSH("sumWhereEqual");
+  CTile sum = agg.sumWhereEqual(regionBits, amountsC, 5);
+  HELAYERS_TIMER_POP();
+  CTile count = agg.countWhereEqual(regionBits, 5);
+  encoder.assertEquals(
+      sum, "sum", vector<double>(he.slotCount(), expectedSums[5]), 0.1);
+  encoder.assertEquals(
+      count, "count", vector<double>(he.slotCount(), expectedCounts[5]), 0.1);
+
+  // SELECT region, SUM(amount), COUNT(*) GROUP BY region
+  vector<int> keys;
+  for (int k = 0; k < numRegions; ++k)
+    keys.push_back(k);
+  vector<CTile> sums, counts;
+  HELAYERS_TIMER_PUSH("groupBy");
+  agg.groupBy(regionBits, amountsC, keys, sums, counts);
+  HELAYERS_TIMER_POP();
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("sumWhereEqual");
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("groupBy");
+  for (int k = 0; k < numRegions; ++k) {
+    encoder.assertEquals(
+        sums[k], "sum", vector<double>(he.slotCount(), expectedSums[k]), 0.1);
+    encoder.assertEquals(counts[k],
+                         "count",
+                         vector<double>(he.slotCount(), expectedCounts[k]),
+                         0.1);
+  }
+
+  cout << "\nFilter and aggregate worked correctly!" << endl;
+}
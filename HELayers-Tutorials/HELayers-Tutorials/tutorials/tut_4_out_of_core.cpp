@@ -0,0 +1,291 @@
+//
+//  tut_4_out_of_core.cpp
+//  HELayers-Tutorials
+//
+
+#include "HELayers-Tutorials-Bridging-Header.h"
+
+#include <filesystem>
+#include <fstream>
+#include <list>
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "helayers/math/CTileTensor.h"
+#include "helayers/math/TTEncoder.h"
+
+// This tutorial shows how to process a CTileTensor that doesn't fit in memory.
+// The tiles of the tensor are kept in a TileSpillStore. The store keeps as
+// many tiles in memory as its memory budget allows, writes the least recently
+// used ones to a scratch file, and reads them back when they are accessed.
+
+using namespace std;
+using namespace helayers;
+
+// A store of CTiles with a bounded memory footprint.
+class TileSpillStore
+{
+  struct Entry
+  {
+    // The tile itself. Empty while the tile is spilled.
+    CTile tile;
+
+    // Whether the tile is currently in memory.
+    bool resident = true;
+
+    // Whether the in-memory tile differs from its copy in the scratch file
+    // (or has no such copy).
+    bool dirty = true;
+
+    // Where the tile's copy starts in the scratch file, or -1 if none.
+    streamoff offset = -1;
+
+    // Estimated memory usage of the tile while it is resident.
+    int64_t bytes = 0;
+
+    // The tile's position in the LRU list, valid while it is resident.
+    list<size_t>::iterator lruPos;
+  };
+
+  const HeContext& he;
+  fstream scratch;
+  int64_t memoryBudgetBytes;
+  int64_t residentBytes = 0;
+  vector<Entry> entries;
+
+  // Resident tile ids, most recently used first.
+  list<size_t> lru;
+
+  int64_t numSpills = 0;
+  int64_t numLoads = 0;
+
+  void touch(size_t id)
+  {
+    Entry& e = entries.at(id);
+    lru.erase(e.lruPos);
+    lru.push_front(id);
+    e.lruPos = lru.begin();
+  }
+
+  // Spills least recently used tiles until the resident tiles fit in the
+  // budget. The tile "keep" is never spilled, so a single tile larger than the
+  // budget can still be accessed.
+  void evictIfNeeded(size_t keep)
+  {
+    while (residentBytes > memoryBudgetBytes && lru.size() > 1) {
+      size_t victim = lru.back();
+      if (victim == keep)
+        break;
+      spill(victim);
+    }
+  }
+
+  void spill(size_t id)
+  {
+    Entry& e = entries.at(id);
+    if (e.dirty) {
+      // Rewritten tiles are appended; their older copy is simply abandoned.
+      scratch.seekp(0, ios::end);
+      e.offset = scratch.tellp();
+      e.tile.save(scratch);
+      if (!scratch)
+        throw runtime_error("TileSpillStore: failed writing to scratch file");
+      e.dirty = false;
+    }
+    e.tile = CTile();
+    e.resident = false;
+    residentBytes -= e.bytes;
+    lru.erase(e.lruPos);
+    ++numSpills;
+  }
+
+  void ensureResident(size_t id)
+  {
+    Entry& e = entries.at(id);
+    if (e.resident) {
+      touch(id);
+      return;
+    }
+    CTile loaded(he);
+    scratch.seekg(e.offset);
+    loaded.load(scratch);
+    if (!scratch)
+      throw runtime_error("TileSpillStore: failed reading from scratch file");
+    e.tile = move(loaded);
+    e.resident = true;
+    e.bytes = e.tile.getEstimatedMemoryUsageBytes();
+    residentBytes += e.bytes;
+    lru.push_front(id);
+    e.lruPos = lru.begin();
+    ++numLoads;
+    evictIfNeeded(id);
+  }
+
+public:
+  /// @brief A constructor.
+  /// @param he                The HeContext of the stored tiles.
+  /// @param scratchFile       A file to spill tiles to. It is truncated.
+  /// @param memoryBudgetBytes Maximal memory (as estimated by
+  ///                          CTile::getEstimatedMemoryUsageBytes()) the
+  ///                          resident tiles may occupy.
+  TileSpillStore(const HeContext& he,
+                 const string& scratchFile,
+                 int64_t memoryBudgetBytes)
+      : he(he),
+        scratch(scratchFile,
+                ios::in | ios::out | ios::trunc | ios::binary),
+        memoryBudgetBytes(memoryBudgetBytes)
+  {
+    if (!scratch)
+      throw runtime_error("TileSpillStore: can't open " + scratchFile);
+  }
+
+  /// @brief Adds a tile to the store and returns its id.
+  size_t add(const CTile& tile)
+  {
+    size_t id = entries.size();
+    entries.emplace_back();
+    Entry& e = entries.back();
+    e.tile = tile;
+    e.bytes = tile.getEstimatedMemoryUsageBytes();
+    residentBytes += e.bytes;
+    lru.push_front(id);
+    e.lruPos = lru.begin();
+    evictIfNeeded(id);
+    return id;
+  }
+
+  /// @brief Adds all tiles of "src" in flat index order, which is the order
+  /// in which TensorIterator traverses the external tensor.
+  void addAll(const CTileTensor& src)
+  {
+    for (int i = 0; i < src.getNumUsedTiles(); ++i)
+      add(src.getTileByFlatIndex(i));
+  }
+
+  /// @brief Returns the tile with the given id, loading it if it was spilled.
+  /// The returned reference is valid until the next call that may load or add
+  /// a tile.
+  const CTile& get(size_t id)
+  {
+    ensureResident(id);
+    return entries.at(id).tile;
+  }
+
+  /// @brief Replaces the tile with the given id.
+  void set(size_t id, const CTile& tile)
+  {
+    Entry& e = entries.at(id);
+    if (e.resident) {
+      residentBytes -= e.bytes;
+      touch(id);
+    } else {
+      lru.push_front(id);
+      e.lruPos = lru.begin();
+      e.resident = true;
+    }
+    e.tile = tile;
+    e.dirty = true;
+    e.bytes = tile.getEstimatedMemoryUsageBytes();
+    residentBytes += e.bytes;
+    evictIfNeeded(id);
+  }
+
+  /// @brief Loads the tiles that will be accessed next, so that they are in
+  /// memory when needed.
+  /// @param order The order in which the tiles will be accessed.
+  /// @param from  Index in "order" of the next tile to be accessed.
+  /// @param count Number of tiles to prefetch. These must fit in the budget
+  ///              together, or the earlier ones will be spilled again.
+  void prefetch(const vector<size_t>& order, size_t from, size_t count)
+  {
+    size_t end = min(order.size(), from + count);
+    // Load the farthest first so the nearest end up most recently used.
+    for (size_t i = end; i > from; --i)
+      ensureResident(order[i - 1]);
+  }
+
+  /// @brief Builds a CTileTensor of the given shape from all stored tiles.
+  /// All tiles are loaded to memory.
+  CTileTensor toCTileTensor(const TTShape& shape)
+  {
+    vector<CTile> tiles;
+    for (size_t i = 0; i < entries.size(); ++i)
+      tiles.push_back(get(i));
+    return CTileTensor::createFromCTileVector(he, shape, tiles);
+  }
+
+  size_t size() const { return entries.size(); }
+  int64_t getResidentBytes() const { return residentBytes; }
+  int64_t getNumSpills() const { return numSpills; }
+  int64_t getNumLoads() const { return numLoads; }
+};
+
+void tut_4_run(HeContext& he);
+
+void tut_4_out_of_core()
+{
+  // As in tut_1_basics, let's choose the same HE CKKS setup
+  HeConfigRequirement requirement;
+  requirement.numSlots = 4096;
+  requirement.multiplicationDepth = 2;
+  requirement.fractionalPartPrecision = 40;
+  requirement.integerPartPrecision = 20;
+  requirement.securityLevel = 128;
+  shared_ptr<HeContext> hePtr = make_shared<SealCkksContext>();
+  hePtr->init(requirement);
+
+  // Let's also make sure we have enough security
+  always_assert(hePtr->getSecurityLevel() >= 128);
+
+  // and do some work
+  tut_4_run(*hePtr);
+}
+
+void tut_4_run(HeContext& he)
+{
+  // We'll encrypt a 512x64 matrix using 64x64 tiles, i.e., 8 tiles.
+  TTEncoder enc(he);
+  DoubleTensor vals({512, 64});
+  vals.initRandom(-1, 1);
+  TTShape shape({64, 64});
+  shape.setOriginalSizes({512, 64});
+  CTileTensor c(he);
+  enc.encodeEncrypt(c, shape, vals);
+
+  // Now we move its tiles to a store that may keep only 3 tiles in memory.
+  // In a real application the tiles would be produced one by one (e.g.,
+  // loaded from a file or encrypted batch by batch) rather than coming from a
+  // tensor that is already in memory.
+  // The scratch file goes to the temporary directory, which an iOS app may
+  // write to, unlike the examples output directory.
+  int64_t tileBytes = c.getTileByFlatIndex(0).getEstimatedMemoryUsageBytes();
+  string scratchFile =
+      (filesystem::temp_directory_path() / "tut_4_scratch.bin").string();
+  TileSpillStore store(he, scratchFile, 3 * tileBytes);
+  store.addAll(c);
+  c = CTileTensor(he);
+  cout << "Tiles spilled while adding: " << store.getNumSpills() << endl;
+
+  // Let's square all elements, traversing the tiles in order.
+  // Before processing each tile we prefetch the one after it, so in a
+  // pipelined setting its loading can overlap the computation.
+  vector<size_t> order(store.size());
+  for (size_t i = 0; i < order.size(); ++i)
+    order[i] = i;
+  for (size_t i = 0; i < order.size(); ++i) {
+    store.prefetch(order, i, 2);
+    CTile t = store.get(order[i]);
+    t.square();
+    store.set(order[i], t);
+  }
+  cout << "Tiles loaded: " << store.getNumLoads()
+       << ", spilled: " << store.getNumSpills() << endl;
+
+  // Finally, let's get back a regular CTileTensor and check the result.
+  CTileTensor res = store.toCTileTensor(shape);
+  vals.elementMultiply(vals);
+  enc.assertEquals(res, "squared out-of-core", vals, 1e-3);
+  filesystem::remove(scratchFile);
+  cout << "\nOut-of-core square worked correctly!" << endl;
+}
@@ -0,0 +1,352 @@
+//
+//  tut_5_permutation_plans.cpp
+//  HELayers-Tutorials
+//
+
+#include "HELayers-Tutorials-Bridging-Header.h"
+
+#include <map>
+#include <mutex>
+#include <sstream>
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "helayers/math/CTileTensor.h"
+#include "helayers/math/TTEncoder.h"
+#include "ParallelFor.h"
+#include "SlotMaps.h"
+
+// This tutorial shows how to move encrypted elements between slots and tiles
+// according to an arbitrary fixed permutation, e.g., the one implied by
+// reordering the dimensions of a CTileTensor.
+// Working out which rotations and masks are needed is costly, so it's done
+// once into a SlotPermutationPlan. Applying the plan is then only a loop of
+// rotations, plaintext multiplications and additions, and plans are cached
+// by the layouts they convert between.
+
+using namespace std;
+using namespace helayers;
+
+// A precomputed schedule of rotations and masks that moves slots of a set of
+// source tiles into a set of destination tiles.
+class SlotPermutationPlan
+{
+  // Elements moving to a single destination tile by the same rotation.
+  struct MaskedTarget
+  {
+    int dstTile;
+    vector<double> mask;
+  };
+
+  // All elements moving out of a source tile by a single rotation. Each
+  // rotation of a source tile is computed once and shared by all destination
+  // tiles that need it.
+  struct RotationGroup
+  {
+    int rotation;
+    vector<MaskedTarget> targets;
+  };
+
+  const HeContext& he;
+  int numSrcTiles;
+  int numDstTiles;
+
+  // groups[s] holds the rotations required of source tile s.
+  vector<vector<RotationGroup>> groups;
+
+  // Masks pre-encoded per chain index, in the order they appear in "groups".
+  // Entries are never removed, so a found entry stays valid after the lock
+  // is released.
+  map<int, vector<PTile>> encodedMasks;
+  mutable mutex encodedMasksLock;
+
+public:
+  /// @brief Builds a plan.
+  /// @param he          The HeContext.
+  /// @param numSrcTiles Number of source tiles.
+  /// @param srcOf       srcOf[d][i] is the (source tile, source slot) to move
+  ///                    into slot i of destination tile d, or (-1, -1) for a
+  ///                    slot that should be zero.
+  SlotPermutationPlan(const HeContext& he,
+                      int numSrcTiles,
+                      const vector<vector<pair<int, int>>>& srcOf)
+      : he(he),
+        numSrcTiles(numSrcTiles),
+        numDstTiles((int)srcOf.size()),
+        groups(numSrcTiles)
+  {
+    int n = he.slotCount();
+    // (source tile, rotation) -> (destination tile -> mask)
+    map<pair<int, int>, map<int, vector<double>>> masks;
+    for (int d = 0; d < numDstTiles; ++d) {
+      always_assert(srcOf[d].size() == (size_t)n);
+      bool used = false;
+      for (int i = 0; i < n; ++i) {
+        int s = srcOf[d][i].first;
+        if (s < 0)
+          continue;
+        always_assert(s < numSrcTiles);
+        int rot = ((srcOf[d][i].second - i) % n + n) % n;
+        vector<double>& mask = masks[{s, rot}][d];
+        mask.resize(n, 0);
+        mask[i] = 1;
+        used = true;
+      }
+      // A destination tile with no elements still needs a ciphertext; it is
+      // produced by masking the first source tile with zeros.
+      if (!used)
+        masks[{0, 0}][d].resize(n, 0);
+    }
+    for (const auto& m : masks) {
+      RotationGroup group;
+      // Prefer the shorter direction, which some backends rotate faster.
+      group.rotation = m.first.second > n / 2 ? m.first.second - n
+                                              : m.first.second;
+      for (const auto& t : m.second)
+        group.targets.push_back(MaskedTarget{t.first, t.second});
+      groups[m.first.first].push_back(move(group));
+    }
+  }
+
+  /// @brief Encodes the masks for inputs at the given chain index. Must be
+  /// called before apply() is used with inputs at this chain index.
+  void prepare(int chainIndex)
+  {
+    lock_guard<mutex> guard(encodedMasksLock);
+    if (encodedMasks.count(chainIndex) > 0)
+      return;
+    Encoder enc(he);
+    vector<PTile>& res = encodedMasks[chainIndex];
+    for (const auto& srcGroups : groups)
+      for (const RotationGroup& g : srcGroups)
+        for (const MaskedTarget& t : g.targets) {
+          res.emplace_back(he);
+          enc.encode(res.back(), t.mask, chainIndex);
+        }
+  }
+
+  /// @brief Applies the plan to the given source tiles and returns the
+  /// destination tiles. Consumes one multiplicative level.
+  vector<CTile> apply(const vector<CTile>& src) const
+  {
+    always_assert(src.size() == (size_t)numSrcTiles);
+    int chainIndex = src.at(0).getChainIndex();
+    const vector<PTile>* found = nullptr;
+    {
+      lock_guard<mutex> guard(encodedMasksLock);
+      auto it = encodedMasks.find(chainIndex);
+      if (it != encodedMasks.end())
+        found = &it->second;
+    }
+    if (found == nullptr)
+      throw runtime_error("SlotPermutationPlan: masks for chain index " +
+                          to_string(chainIndex) + " were not prepared");
+    const vector<PTile>& masks = *found;
+
+    vector<CTile> res(numDstTiles);
+    vector<bool> started(numDstTiles, false);
+    size_t maskInd = 0;
+    for (int s = 0; s < numSrcTiles; ++s) {
+      for (const RotationGroup& g : groups[s]) {
+        CTile rotated(src[s]);
+        if (g.rotation != 0)
+          rotated.rotate(g.rotation);
+        for (const MaskedTarget& t : g.targets) {
+          CTile term(rotated);
+          term.multiplyPlainRaw(masks[maskInd++]);
+          if (started[t.dstTile]) {
+            res[t.dstTile].addRaw(term);
+          } else {
+            res[t.dstTile] = move(term);
+            started[t.dstTile] = true;
+          }
+        }
+      }
+    }
+    // All terms of a tile share the same scale, so a single rescale suffices.
+    parallelFor(0, numDstTiles, [&](int d) { res[d].rescale(); });
+    return res;
+  }
+
+  /// @brief Returns the total number of rotations apply() performs.
+  int getNumRotations() const
+  {
+    int res = 0;
+    for (const auto& srcGroups : groups)
+      for (const RotationGroup& g : srcGroups)
+        if (g.rotation != 0)
+          ++res;
+    return res;
+  }
+};
+
+// Builds a plan that converts a tensor packed with "srcShape" to the same
+// tensor with its dimensions reordered by "dimOrder" and packed with
+// "dstShape".
+shared_ptr<SlotPermutationPlan> buildReorderDimsPlan(
+    const HeContext& he,
+    const TTShape& srcShape,
+    const vector<DimInt>& dimOrder,
+    const TTShape& dstShape)
+{
+  vector<vector<int64_t>> srcMap = getSlotElementMap(he, srcShape);
+  vector<vector<int64_t>> dstMap = getSlotElementMap(he, dstShape);
+
+  // Where each element of the source tensor lives.
+  vector<DimInt> srcSizes = srcShape.getOriginalSizes();
+  DimInt numElements = 1;
+  for (DimInt s : srcSizes)
+    numElements *= s;
+  vector<pair<int, int>> location(numElements, {-1, -1});
+  for (size_t t = 0; t < srcMap.size(); ++t)
+    for (size_t i = 0; i < srcMap[t].size(); ++i) {
+      int64_t e = srcMap[t][i];
+      if (e >= 0 && location[e].first < 0)
+        location[e] = {(int)t, (int)i};
+    }
+
+  // Flat element index in the reordered tensor -> flat index in the source.
+  // Both use the first order layout, where the first dim runs fastest.
+  DimInt numDims = static_cast<DimInt>(srcSizes.size());
+  vector<DimInt> dstSizes(numDims);
+  vector<DimInt> srcStrides(numDims, 1);
+  for (DimInt i = 1; i < numDims; ++i)
+    srcStrides[i] = srcStrides[i - 1] * srcSizes[i - 1];
+  for (DimInt i = 0; i < numDims; ++i)
+    dstSizes[i] = srcSizes[dimOrder[i]];
+
+  vector<vector<pair<int, int>>> srcOf(dstMap.size());
+  for (size_t t = 0; t < dstMap.size(); ++t) {
+    srcOf[t].assign(dstMap[t].size(), {-1, -1});
+    for (size_t i = 0; i < dstMap[t].size(); ++i) {
+      int64_t e = dstMap[t][i];
+      if (e < 0)
+        continue;
+      int64_t srcFlat = 0;
+      for (DimInt d = 0; d < numDims; ++d) {
+        srcFlat += (e % dstSizes[d]) * srcStrides[dimOrder[d]];
+        e /= dstSizes[d];
+      }
+      srcOf[t][i] = location[srcFlat];
+    }
+  }
+  return make_shared<SlotPermutationPlan>(he, srcMap.size(), srcOf);
+}
+
+// A cache of permutation plans, keyed by the source layout, the target
+// layout and the dims order.
+class PermutationPlanCache
+{
+  const HeContext& he;
+  map<string, shared_ptr<SlotPermutationPlan>> plans;
+  mutex lock;
+
+  static string getKey(const TTShape& srcShape,
+                       const vector<DimInt>& dimOrder,
+                       const TTShape& dstShape)
+  {
+    stringstream key;
+    srcShape.save(key);
+    dstShape.save(key);
+    for (DimInt d : dimOrder)
+      key << d << ",";
+    return key.str();
+  }
+
+public:
+  PermutationPlanCache(const HeContext& he) : he(he) {}
+
+  /// @brief Returns a plan for reordering the dims of a tensor packed with
+  /// "srcShape" into "dstShape", prepared for the given chain index. The plan
+  /// is built only on first use.
+  shared_ptr<SlotPermutationPlan> getReorderDimsPlan(
+      const TTShape& srcShape,
+      const vector<DimInt>& dimOrder,
+      const TTShape& dstShape,
+      int chainIndex)
+  {
+    lock_guard<mutex> guard(lock);
+    shared_ptr<SlotPermutationPlan>& plan =
+        plans[getKey(srcShape, dimOrder, dstShape)];
+    if (!plan)
+      plan = buildReorderDimsPlan(he, srcShape, dimOrder, dstShape);
+    plan->prepare(chainIndex);
+    return plan;
+  }
+
+  /// @brief Returns "src" with its dims reordered and packed with "dstShape".
+  CTileTensor reorderDims(const CTileTensor& src,
+                          const vector<DimInt>& dimOrder,
+                          const TTShape& dstShape)
+  {
+    shared_ptr<SlotPermutationPlan> plan = getReorderDimsPlan(
+        src.getShape(), dimOrder, dstShape, src.getChainIndex());
+    vector<CTile> tiles;
+    for (int i = 0; i < src.getNumUsedTiles(); ++i)
+      tiles.push_back(src.getTileByFlatIndex(i));
+    return CTileTensor::createFromCTileVector(
+        he, dstShape, plan->apply(tiles));
+  }
+
+  size_t size() const { return plans.size(); }
+};
+
+void tut_5_run(HeContext& he);
+
+void tut_5_permutation_plans()
+{
+  // As in tut_1_basics, let's choose the same HE CKKS setup
+  HeConfigRequirement requirement;
+  requirement.numSlots = 4096;
+  requirement.multiplicationDepth = 2;
+  requirement.fractionalPartPrecision = 40;
+  requirement.integerPartPrecision = 20;
+  requirement.securityLevel = 128;
+  shared_ptr<HeContext> hePtr = make_shared<SealCkksContext>();
+  hePtr->init(requirement);
+
+  // Let's also make sure we have enough security
+  always_assert(hePtr->getSecurityLevel() >= 128);
+
+  // and do some work
+  tut_5_run(*hePtr);
+}
+
+void tut_5_run(HeContext& he)
+{
+  TTEncoder enc(he);
+  PermutationPlanCache cache(he);
+
+  // We'll transpose 16x64 matrices. The source is packed in a single 16x256
+  // tile, and the transposed 64x16 matrix in a single 256x16 tile.
+  TTShape srcShape({16, 256});
+  srcShape.setOriginalSizes({16, 64});
+  TTShape dstShape({256, 16});
+  dstShape.setOriginalSizes({64, 16});
+  vector<DimInt> dimOrder{1, 0};
+
+  // Our "inference requests" all apply the same transposition. Only the first
+  // one builds the plan; the rest only execute it.
+  int chainIndex = -1;
+  for (int request = 0; request < 3; ++request) {
+    DoubleTensor vals({16, 64});
+    vals.initRandom(-1, 1);
+    CTileTensor c(he);
+    enc.encodeEncrypt(c, srcShape, vals);
+    chainIndex = c.getChainIndex();
+
+    HELAYERS_TIMER_PUSH("reorderDims with plan");
+    CTileTensor res = cache.reorderDims(c, dimOrder, dstShape);
+    HELAYERS_TIMER_POP();
+
+    vals.reorderDims(dimOrder);
+    enc.assertEquals(res, "reordered", vals, 1e-3);
+  }
+  always_assert(cache.size() == 1);
+  cout << "Rotations per execution: "
+       << cache.getReorderDimsPlan(srcShape, dimOrder, dstShape, chainIndex)
+              ->getNumRotations()
+       << endl;
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("reorderDims with plan");
+  cout << "\nCached permutation plan worked correctly!" << endl;
+}
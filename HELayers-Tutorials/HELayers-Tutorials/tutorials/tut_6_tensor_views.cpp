@@ -0,0 +1,329 @@
+//
+//  tut_6_tensor_views.cpp
+//  HELayers-Tutorials
+//
+
+#include "HELayers-Tutorials-Bridging-Header.h"
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "helayers/math/CTileTensor.h"
+#include "helayers/math/TTEncoder.h"
+#include "CowCTile.h"
+
+// This tutorial shows how to slice, concatenate and flatten encrypted tensors
+// without copying ciphertexts.
+// CTileTensor::getSlice() and friends return a new tensor holding copies of
+// the tiles they use. When slices are aligned with tile boundaries, the
+// resulting tiles are exactly the source tiles, so a view can point to the
+// source tiles instead. The tiles are held as CowCTile objects, so a tile is
+// copied only when it is modified while shared by another view.
+
+using namespace std;
+using namespace helayers;
+
+// A CTileTensor whose tiles may be shared with other views.
+class CTileTensorView
+{
+  const HeContext* he;
+  TTShape shape;
+
+  // The tiles in flat index order (first external dim runs fastest).
+  vector<CowCTile> tiles;
+
+  CTileTensorView(const HeContext& he,
+                  const TTShape& shape,
+                  vector<CowCTile>&& tiles)
+      : he(&he), shape(shape), tiles(move(tiles))
+  {
+    always_assert(this->tiles.size() == (size_t)shape.getNumUsedTiles());
+  }
+
+  // Returns the strides of the flat tile index along each external dim.
+  vector<DimInt> getExternalStrides() const
+  {
+    vector<DimInt> sizes = shape.getExternalSizes();
+    vector<DimInt> res(sizes.size(), 1);
+    for (size_t i = 1; i < sizes.size(); ++i)
+      res[i] = res[i - 1] * sizes[i - 1];
+    return res;
+  }
+
+  // Copies the tiles whose external index along "dim" is in
+  // [startExt, startExt + numExt) into "dst", following flat index order.
+  void collectTiles(vector<CowCTile>& dst,
+                    DimInt dim,
+                    DimInt startExt,
+                    DimInt numExt,
+                    DimInt resExtAlongDim,
+                    DimInt offsetInRes) const
+  {
+    vector<DimInt> sizes = shape.getExternalSizes();
+    vector<DimInt> strides = getExternalStrides();
+    vector<DimInt> resSizes(sizes);
+    resSizes.at(dim) = resExtAlongDim;
+    vector<DimInt> resStrides(sizes.size(), 1);
+    for (size_t i = 1; i < sizes.size(); ++i)
+      resStrides[i] = resStrides[i - 1] * resSizes[i - 1];
+    for (size_t flat = 0; flat < tiles.size(); ++flat) {
+      DimInt rem = static_cast<DimInt>(flat);
+      DimInt resFlat = 0;
+      bool inRange = true;
+      for (DimInt d = static_cast<DimInt>(sizes.size()) - 1; d >= 0; --d) {
+        DimInt ind = rem / strides[d];
+        rem %= strides[d];
+        if (d == dim) {
+          if (ind < startExt || ind >= startExt + numExt) {
+            inRange = false;
+            break;
+          }
+          ind = ind - startExt + offsetInRes;
+        }
+        resFlat += ind * resStrides[d];
+      }
+      if (inRange)
+        dst.at(resFlat) = tiles[flat];
+    }
+  }
+
+  void validateAlignedDim(DimInt dim) const
+  {
+    const TTDim& d = shape.getDim(dim);
+    if (d.isInterleaved() || d.getNumDuplicated() > 1)
+      throw invalid_argument(
+          "CTileTensorView: dim " + to_string(dim) +
+          " must be neither interleaved nor duplicated");
+  }
+
+public:
+  /// @brief Constructs a view holding the tiles of "src". This copies the
+  /// tiles once; views derived from this one share them.
+  CTileTensorView(const CTileTensor& src)
+      : he(&src.getHeContext()), shape(src.getShape())
+  {
+    for (int i = 0; i < src.getNumUsedTiles(); ++i)
+      tiles.emplace_back(src.getTileByFlatIndex(i));
+  }
+
+  /// @brief Returns a view of the slice [startIndex, startIndex + sliceDepth)
+  /// of dim "dim". Like CTileTensor::getSlice(), but the tiles are shared.
+  /// startIndex must be a multiple of the dim's tile size.
+  CTileTensorView getSlice(DimInt dim,
+                           DimInt startIndex,
+                           DimInt sliceDepth = 1) const
+  {
+    validateAlignedDim(dim);
+    const TTDim& d = shape.getDim(dim);
+    DimInt tileSize = d.getTileSize();
+    if (startIndex >= d.getOriginalSize())
+      throw invalid_argument("CTileTensorView: slice start " +
+                             to_string(startIndex) +
+                             " is out of range for original size " +
+                             to_string(d.getOriginalSize()));
+    if (startIndex % tileSize != 0)
+      throw invalid_argument("CTileTensorView: slice start " +
+                             to_string(startIndex) +
+                             " is not aligned to tile size " +
+                             to_string(tileSize));
+    DimInt endIndex = min(startIndex + sliceDepth, d.getOriginalSize());
+
+    TTShape resShape(shape);
+    TTDim& resDim = resShape.getDim(dim);
+    resDim.setOriginalSize(endIndex - startIndex);
+    // Elements following the slice inside its last tile aren't cleared, so
+    // they become garbage as far as the slice is concerned.
+    if (endIndex < d.getOriginalSize() && endIndex % tileSize != 0)
+      resDim.setAreUnusedSlotsUnknown(true);
+
+    DimInt startExt = startIndex / tileSize;
+    DimInt numExt = (endIndex - startIndex + tileSize - 1) / tileSize;
+    vector<CowCTile> resTiles(resShape.getNumUsedTiles(), CowCTile(*he));
+    collectTiles(resTiles, dim, startExt, numExt, numExt, 0);
+    return CTileTensorView(*he, resShape, move(resTiles));
+  }
+
+  /// @brief Returns a view of this tensor concatenated with "other" along
+  /// "dim". Like CTileTensor::getConcatenate(), but the tiles are shared.
+  /// The original size of "dim" in this tensor must be a multiple of its tile
+  /// size, so that the tiles of "other" start at a tile boundary.
+  CTileTensorView getConcatenate(const CTileTensorView& other, DimInt dim) const
+  {
+    validateAlignedDim(dim);
+    other.validateAlignedDim(dim);
+    const TTDim& d = shape.getDim(dim);
+    const TTDim& od = other.shape.getDim(dim);
+    if (d.getOriginalSize() % d.getTileSize() != 0)
+      throw invalid_argument("CTileTensorView: can't concatenate along dim " +
+                             to_string(dim) +
+                             " since its tiles are not exactly filled");
+    TTShape a(shape), b(other.shape);
+    a.getDim(dim).setOriginalSize(1);
+    b.getDim(dim).setOriginalSize(1);
+    if (a != b)
+      throw invalid_argument(
+          "CTileTensorView: shapes differ in a dim other than " +
+          to_string(dim));
+
+    TTShape resShape(shape);
+    TTDim& resDim = resShape.getDim(dim);
+    resDim.setOriginalSize(d.getOriginalSize() + od.getOriginalSize());
+    resDim.setAreUnusedSlotsUnknown(od.getAreUnusedSlotsUnknown());
+
+    DimInt numExt = d.getExternalSize();
+    DimInt otherNumExt = od.getExternalSize();
+    vector<CowCTile> resTiles(resShape.getNumUsedTiles(), CowCTile(*he));
+    collectTiles(resTiles, dim, 0, numExt, numExt + otherNumExt, 0);
+    other.collectTiles(
+        resTiles, dim, 0, otherNumExt, numExt + otherNumExt, numExt);
+    return CTileTensorView(*he, resShape, move(resTiles));
+  }
+
+  /// @brief Returns a view in which dims [startDim, endDim) are flattened
+  /// into one. Like CTileTensor::getFlatten(), but the tiles are shared.
+  /// Supported when all flattened dims are fully duplicated, as in
+  /// CTileTensor::getFlatten(), or all have a tile size of 1. In both cases
+  /// flattening doesn't move any slot.
+  CTileTensorView getFlatten(DimInt startDim, DimInt endDim) const
+  {
+    if (startDim < 0 || endDim > shape.getNumDims() || startDim >= endDim)
+      throw invalid_argument("CTileTensorView: can't flatten dims [" +
+                             to_string(startDim) + ", " + to_string(endDim) +
+                             ")");
+    bool duplicated = true, interleaved = true;
+    DimInt flatSize = 1, flatTileSize = 1;
+    for (DimInt i = startDim; i < endDim; ++i) {
+      const TTDim& d = shape.getDim(i);
+      duplicated = duplicated && d.isFullyDuplicated();
+      interleaved = interleaved && d.isInterleaved();
+      flatSize *= d.getOriginalSize();
+      flatTileSize *= d.getTileSize();
+    }
+    TTDim flat(flatSize, 1);
+    if (duplicated) {
+      flat = TTDim(1, flatTileSize, flatTileSize, false, interleaved);
+    } else {
+      for (DimInt i = startDim; i < endDim; ++i) {
+        const TTDim& d = shape.getDim(i);
+        validateAlignedDim(i);
+        if (d.getTileSize() != 1)
+          throw invalid_argument("CTileTensorView: can't flatten dim " +
+                                 to_string(i) + " with tile size " +
+                                 to_string(d.getTileSize()));
+      }
+    }
+    vector<TTDim> dims;
+    for (DimInt i = 0; i < shape.getNumDims(); ++i) {
+      if (i == startDim)
+        dims.push_back(flat);
+      else if (i < startDim || i >= endDim)
+        dims.push_back(shape.getDim(i));
+    }
+    return CTileTensorView(*he, TTShape(dims), vector<CowCTile>(tiles));
+  }
+
+  /// @brief Returns the tile with the given flat index, for reading.
+  const CTile& getTileByFlatIndex(DimInt i) const { return tiles.at(i).get(); }
+
+  /// @brief Returns the tile with the given flat index, for writing. If the
+  /// tile is shared with another view it's copied first, so the other views
+  /// are unaffected.
+  CTile& getMutableTileByFlatIndex(DimInt i)
+  {
+    return tiles.at(i).getMutable();
+  }
+
+  /// @brief Returns whether the tile with the given flat index is shared with
+  /// another view.
+  bool isTileShared(DimInt i) const { return tiles.at(i).isShared(); }
+
+  /// @brief Returns a regular CTileTensor with a copy of this view's tiles.
+  CTileTensor materialize() const
+  {
+    vector<CTile> copies;
+    for (const auto& t : tiles)
+      copies.push_back(t.get());
+    return CTileTensor::createFromCTileVector(*he, shape, copies);
+  }
+
+  inline const TTShape& getShape() const { return shape; }
+  inline int getNumUsedTiles() const { return (int)tiles.size(); }
+};
+
+void tut_6_run(HeContext& he);
+
+void tut_6_tensor_views()
+{
+  // As in tut_1_basics, let's choose the same HE CKKS setup
+  HeConfigRequirement requirement;
+  requirement.numSlots = 4096;
+  requirement.multiplicationDepth = 2;
+  requirement.fractionalPartPrecision = 40;
+  requirement.integerPartPrecision = 20;
+  requirement.securityLevel = 128;
+  shared_ptr<HeContext> hePtr = make_shared<SealCkksContext>();
+  hePtr->init(requirement);
+
+  // Let's also make sure we have enough security
+  always_assert(hePtr->getSecurityLevel() >= 128);
+
+  // and do some work
+  tut_6_run(*hePtr);
+}
+
+void tut_6_run(HeContext& he)
+{
+  // We'll encrypt 32 records of 1024 features, 4 records per tile.
+  TTEncoder enc(he);
+  DoubleTensor vals({32, 1024});
+  vals.initRandom(-1, 1);
+  TTShape shape({4, 1024});
+  shape.setOriginalSizes({32, 1024});
+  CTileTensor c(he);
+  enc.encodeEncrypt(c, shape, vals);
+
+  CTileTensorView all(c);
+
+  // Take records 8 to 19. No ciphertext is copied.
+  CTileTensorView mid = all.getSlice(0, 8, 12);
+  enc.assertEquals(
+      mid.materialize(), "slice", vals.getSlice(0, 8, 12), 1e-3);
+  always_assert(mid.isTileShared(0));
+
+  // Now drop them, by concatenating records 0-7 with records 20-31.
+  // Both slices start at a tile boundary, and the first one fills its tiles
+  // exactly, so the result is made of source tiles only.
+  CTileTensorView head = all.getSlice(0, 0, 8);
+  CTileTensorView tail = all.getSlice(0, 20, 12);
+  CTileTensorView rest = head.getConcatenate(tail, 0);
+  DoubleTensor expected({20, 1024});
+  expected.putSlice(0, 0, vals.getSlice(0, 0, 8));
+  expected.putSlice(0, 8, vals.getSlice(0, 20, 12));
+  enc.assertEquals(rest.materialize(), "concatenate", expected, 1e-3);
+
+  // Flatten the two duplicated dims of a [records, *, *, features] tensor.
+  // Duplicated slots hold the same element, so no slot moves and the view
+  // matches CTileTensor::getFlatten().
+  TTShape dupShape({4, 2, 2, 256});
+  dupShape.setOriginalSizes({8, 1, 1, 256});
+  dupShape = dupShape.getWithDuplicatedDims({1, 2});
+  DoubleTensor dupVals({8, 1, 1, 256});
+  dupVals.initRandom(-1, 1);
+  CTileTensor dup(he);
+  enc.encodeEncrypt(dup, dupShape, dupVals);
+  CTileTensor flatRef = dup.getFlatten(1, 3);
+  CTileTensorView dupView(dup);
+  CTileTensorView flat = dupView.getFlatten(1, 3);
+  always_assert(flat.getShape() == flatRef.getShape());
+  always_assert(flat.isTileShared(0));
+  enc.assertEquals(flat.materialize(),
+                   "flatten",
+                   enc.decryptDecodeDouble(flatRef),
+                   1e-3);
+
+  // Modifying a shared tile copies it, leaving the other views intact.
+  rest.getMutableTileByFlatIndex(0).multiplyScalar(2);
+  always_assert(!rest.isTileShared(0));
+  enc.assertEquals(all.materialize(), "source unchanged", vals, 1e-3);
+
+  cout << "\nTensor views worked correctly!" << endl;
+}
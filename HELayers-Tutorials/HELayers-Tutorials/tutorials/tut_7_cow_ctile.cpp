@@ -0,0 +1,128 @@
+//
+//  tut_7_cow_ctile.cpp
+//  HELayers-Tutorials
+//
+
+#include "HELayers-Tutorials-Bridging-Header.h"
+
+#include <map>
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "CowCTile.h"
+#include "ParallelFor.h"
+
+// This tutorial shows how to avoid copying ciphertexts that are never
+// modified.
+// Copying a CTile clones the underlying ciphertext, which is as expensive as
+// the ciphertext is large. Code that copies a ciphertext and then modifies
+// only some of the copies pays for all of them. A CowCTile shares the
+// ciphertext between copies and clones it only when a copy is modified.
+
+using namespace std;
+using namespace helayers;
+
+// Like CTileRotationCache, but keeps the rotation subject without copying it.
+class CowRotationCache
+{
+  map<int, CowCTile> cache;
+
+public:
+  CowRotationCache(const CowCTile& c) { cache.emplace(0, c); }
+
+  /// @brief Returns "c" rotated by "rot". Each rotation is computed once.
+  CowCTile getRotated(int rot)
+  {
+    auto it = cache.find(rot);
+    if (it == cache.end()) {
+      CowCTile rotated(cache.at(0));
+      rotated.rotate(rot);
+      it = cache.emplace(rot, move(rotated)).first;
+    }
+    // A copy of a cached rotation costs nothing until the caller modifies it
+    return it->second;
+  }
+};
+
+void tut_7_run(HeContext& he);
+
+void tut_7_cow_ctile()
+{
+  // As in tut_1_basics, let's choose the same HE CKKS setup
+  HeConfigRequirement requirement;
+  requirement.numSlots = 4096;
+  requirement.multiplicationDepth = 2;
+  requirement.fractionalPartPrecision = 40;
+  requirement.integerPartPrecision = 20;
+  requirement.securityLevel = 128;
+  shared_ptr<HeContext> hePtr = make_shared<SealCkksContext>();
+  hePtr->init(requirement);
+
+  // Let's also make sure we have enough security
+  always_assert(hePtr->getSecurityLevel() >= 128);
+
+  // and do some work
+  tut_7_run(*hePtr);
+}
+
+void tut_7_run(HeContext& he)
+{
+  Encoder encoder(he);
+  CTile c(he);
+  encoder.encodeEncrypt(c, vector<double>{1, 2, 3});
+
+  // We move our ciphertext into a CowCTile, so it's not copied even once.
+  CowCTile a(move(c));
+
+  // Copying a CowCTile is O(1): both objects now hold the same ciphertext.
+  CowCTile b(a);
+  always_assert(a.isShared() && b.isShared());
+
+  // Modifying b gives it its own ciphertext. a remains (1,2,3).
+  b.multiplyScalar(2);
+  always_assert(!a.isShared() && !b.isShared());
+  encoder.assertEquals(a.get(), "a unchanged", vector<double>{1, 2, 3}, 1e-5);
+  encoder.assertEquals(b.get(), "b doubled", vector<double>{2, 4, 6}, 1e-5);
+
+  // Let's compare the cost of making many copies of which only few are
+  // modified.
+  const int numCopies = 64;
+  {
+    HELAYERS_TIMER_PUSH("copy CTile");
+    vector<CTile> copies(numCopies, a.get());
+    copies[0].negate();
+    HELAYERS_TIMER_POP();
+  }
+  {
+    HELAYERS_TIMER_PUSH("copy CowCTile");
+    vector<CowCTile> copies(numCopies, a);
+    copies[0].negate();
+    HELAYERS_TIMER_POP();
+  }
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("copy CTile");
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("copy CowCTile");
+
+  // Copies may be modified from different threads: each detaches
+  // independently.
+  vector<CowCTile> copies(8, a);
+  parallelFor(0, (int)copies.size(), [&](int i) {
+    copies[i].addScalar((double)i);
+  });
+  for (size_t i = 0; i < copies.size(); ++i) {
+    double d = (double)i;
+    encoder.assertEquals(copies[i].get(),
+                         "parallel copy",
+                         vector<double>{1.0 + d, 2.0 + d, 3.0 + d},
+                         1e-5);
+  }
+
+  // A rotation cache can hold its subject and hand out rotations for free.
+  CowRotationCache cache(a);
+  CowCTile r = cache.getRotated(1);
+  encoder.assertEquals(r.get(), "rotated", vector<double>{2, 3}, 1e-5);
+  r.square();
+  CowCTile r2 = cache.getRotated(1);
+  encoder.assertEquals(r2.get(), "cache unchanged", vector<double>{2, 3}, 1e-5);
+
+  cout << "\nCopy-on-write CTile worked correctly!" << endl;
+}
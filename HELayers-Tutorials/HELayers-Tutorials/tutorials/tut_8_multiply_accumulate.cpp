@@ -0,0 +1,120 @@
+//
+//  tut_8_multiply_accumulate.cpp
+//  HELayers-Tutorials
+//
+
+#include "HELayers-Tutorials-Bridging-Header.h"
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "helayers/math/TTEncoder.h"
+#include "MultiplyAccumulate.h"
+
+// This tutorial shows how to compute sums of products, as in dot products,
+// polynomial evaluation and convolution, while relinearizing and rescaling
+// only once.
+// A regular multiply() relinearizes and rescales its result. When the
+// products are only summed, the raw products can be added first, and the sum
+// relinearized and rescaled once.
+
+using namespace std;
+using namespace helayers;
+
+void tut_8_run(HeContext& he);
+
+void tut_8_multiply_accumulate()
+{
+  // As in tut_1_basics, let's choose the same HE CKKS setup
+  HeConfigRequirement requirement;
+  requirement.numSlots = 4096;
+  requirement.multiplicationDepth = 2;
+  requirement.fractionalPartPrecision = 40;
+  requirement.integerPartPrecision = 20;
+  requirement.securityLevel = 128;
+  shared_ptr<HeContext> hePtr = make_shared<SealCkksContext>();
+  hePtr->init(requirement);
+
+  // Let's also make sure we have enough security
+  always_assert(hePtr->getSecurityLevel() >= 128);
+
+  // and do some work
+  tut_8_run(*hePtr);
+}
+
+void tut_8_run(HeContext& he)
+{
+  Encoder encoder(he);
+
+  // We'll compute sum_i a_i * b_i + sum_i a_i * w_i, where a_i, b_i are
+  // encrypted and w_i are plaintexts.
+  const int n = 16;
+  vector<CTile> as, bs;
+  vector<PTile> ws;
+  vector<double> expected(3, 0);
+  for (int i = 0; i < n; ++i) {
+    vector<double> a{0.1 * i, 0.2, -0.05 * i};
+    vector<double> b{0.3, -0.1 * i, 0.5};
+    vector<double> w{1, 2, 3};
+    as.emplace_back(he);
+    bs.emplace_back(he);
+    ws.emplace_back(he);
+    encoder.encodeEncrypt(as.back(), a);
+    encoder.encodeEncrypt(bs.back(), b);
+    encoder.encode(ws.back(), w);
+    for (int j = 0; j < 3; ++j)
+      expected[j] += a[j] * b[j] + a[j] * w[j];
+  }
+
+  // The regular way: 2n rescales and n relinearizations.
+  HELAYERS_TIMER_PUSH("regular");
+  CTile regular(he);
+  encoder.encodeEncrypt(regular, 0.0, as[0].getChainIndex() - 1);
+  for (int i = 0; i < n; ++i) {
+    multiplyAdd(regular, as[i], bs[i]);
+    multiplyPlainAdd(regular, as[i], ws[i]);
+  }
+  HELAYERS_TIMER_POP();
+  encoder.assertEquals(regular, "regular", expected, 1e-3);
+
+  // With an accumulator: one rescale and one relinearization.
+  HELAYERS_TIMER_PUSH("accumulated");
+  MultiplyAccumulator acc(he);
+  for (int i = 0; i < n; ++i) {
+    acc.multiplyAdd(as[i], bs[i]);
+    acc.multiplyPlainAdd(as[i], ws[i]);
+  }
+  CTile accumulated = acc.getResult();
+  HELAYERS_TIMER_POP();
+  encoder.assertEquals(accumulated, "accumulated", expected, 1e-3);
+  always_assert(accumulated.getChainIndex() == regular.getChainIndex());
+
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("regular");
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("accumulated");
+
+  // The same works for tile tensors. Here we compute sum_i A_i * W_i for
+  // 16x256 encrypted matrices A_i and plaintext matrices W_i.
+  TTEncoder ttEnc(he);
+  TTShape shape({16, 256});
+  shape.setOriginalSizes({16, 256});
+  DoubleTensor expectedT({16, 256});
+  CTileTensor accT(he);
+  for (int i = 0; i < 4; ++i) {
+    DoubleTensor a({16, 256}), w({16, 256});
+    a.initRandom(-1, 1);
+    w.initRandom(-1, 1);
+    CTileTensor aC(he);
+    PTileTensor wP(he);
+    ttEnc.encodeEncrypt(aC, shape, a);
+    ttEnc.encode(wP, shape, w);
+    if (i == 0)
+      accT = aC.getMultiplyPlainRaw(wP);
+    else
+      multiplyPlainAddRaw(accT, aC, wP);
+    a.elementMultiply(w);
+    expectedT.elementAdd(a);
+  }
+  accT.relinearizeAndRescale();
+  ttEnc.assertEquals(accT, "accumulated tensors", expectedT, 1e-3);
+
+  cout << "\nMultiply-accumulate worked correctly!" << endl;
+}
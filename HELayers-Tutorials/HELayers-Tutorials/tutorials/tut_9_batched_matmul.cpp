@@ -0,0 +1,167 @@
+//
+//  tut_9_batched_matmul.cpp
+//  HELayers-Tutorials
+//
+
+#include "HELayers-Tutorials-Bridging-Header.h"
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "helayers/math/CTileTensor.h"
+#include "helayers/math/TTEncoder.h"
+
+// This tutorial shows how to multiply a batch of encrypted matrices by a
+// plaintext matrix, or by a batch of encrypted matrices, in one operation.
+// Looping over the batch and multiplying each matrix separately fills every
+// tile with one matrix, duplicated to fill the slots, so it takes a tile
+// multiplication per matrix and repeats the same rotations for every matrix.
+// Instead we add the batch as another tile tensor dimension. The batch items
+// then share tiles, so each rotation and each multiplication serves all the
+// items in a tile at once, and a plaintext matrix is encoded only once for
+// the batch.
+
+using namespace std;
+using namespace helayers;
+
+// To multiply [n, k] matrices by [k, m] matrices we use 4-D tile tensors:
+//   A: [n, k, *, batch]
+//   W: [*, k, m, *]      for a matrix shared by all batch items, or
+//   W: [*, k, m, batch]  for a matrix per batch item,
+// where * marks a duplicated dim. Multiplying them and summing over dim 1
+// yields the batch of products, shaped [n, 1, m, batch].
+
+// Returns the shape for packing a batch of [n, k] matrices.
+TTShape getBatchedLeftShape(const vector<DimInt>& tileSizes,
+                            DimInt n,
+                            DimInt k,
+                            DimInt batch)
+{
+  TTShape res(tileSizes);
+  res.setOriginalSizes({n, k, 1, batch});
+  return res.getWithDuplicatedDim(2);
+}
+
+// Returns the shape for packing a [k, m] matrix shared by all batch items
+// (batch = 1), or a batch of [k, m] matrices.
+TTShape getBatchedRightShape(const vector<DimInt>& tileSizes,
+                             DimInt k,
+                             DimInt m,
+                             DimInt batch = 1)
+{
+  TTShape res(tileSizes);
+  res.setOriginalSizes({1, k, m, batch});
+  if (batch == 1)
+    return res.getWithDuplicatedDims({0, 3});
+  return res.getWithDuplicatedDim(0);
+}
+
+// Multiplies a batch of encrypted matrices by a plaintext matrix.
+// a and w are packed with getBatchedLeftShape() and getBatchedRightShape().
+CTileTensor batchedMatMul(const CTileTensor& a, const PTileTensor& w)
+{
+  return a.getMultiplyPlainAndSum(w, 1);
+}
+
+// Multiplies a batch of encrypted matrices by a batch of encrypted matrices.
+CTileTensor batchedMatMul(const CTileTensor& a, const CTileTensor& w)
+{
+  return a.getMultiplyAndSum(w, 1);
+}
+
+void tut_9_run(HeContext& he);
+
+void tut_9_batched_matmul()
+{
+  // As in tut_1_basics, let's choose the same HE CKKS setup
+  HeConfigRequirement requirement;
+  requirement.numSlots = 4096;
+  requirement.multiplicationDepth = 2;
+  requirement.fractionalPartPrecision = 40;
+  requirement.integerPartPrecision = 20;
+  requirement.securityLevel = 128;
+  shared_ptr<HeContext> hePtr = make_shared<SealCkksContext>();
+  hePtr->init(requirement);
+
+  // Let's also make sure we have enough security
+  always_assert(hePtr->getSecurityLevel() >= 128);
+
+  // and do some work
+  tut_9_run(*hePtr);
+}
+
+void tut_9_run(HeContext& he)
+{
+  const DimInt n = 8, k = 8, m = 8, batch = 16;
+  TTEncoder enc(he);
+
+  // Our 16 queries, as a [n, k, 1, batch] tensor, and the weights.
+  DoubleTensor queries({n, k, 1, batch});
+  queries.initRandom(-1, 1);
+  DoubleTensor weights({1, k, m, 1});
+  weights.initRandom(-1, 1);
+  DoubleTensor expected({n, 1, m, batch});
+  for (DimInt b = 0; b < batch; ++b)
+    for (DimInt i = 0; i < n; ++i)
+      for (DimInt j = 0; j < m; ++j)
+        for (DimInt l = 0; l < k; ++l)
+          expected.at(i, 0, j, b) +=
+              queries.at(i, l, 0, b) * weights.at(0, l, j, 0);
+
+  // 8x8x8x8 tiles fill all 4096 slots, 8 batch items per tile.
+  vector<DimInt> tileSizes{8, 8, 8, 8};
+  CTileTensor a(he);
+  enc.encodeEncrypt(
+      a, getBatchedLeftShape(tileSizes, n, k, batch), queries);
+  PTileTensor w(he);
+  enc.encode(w, getBatchedRightShape(tileSizes, k, m), weights);
+
+  HELAYERS_TIMER_PUSH("batched");
+  CTileTensor res = batchedMatMul(a, w);
+  HELAYERS_TIMER_POP();
+  enc.assertEquals(res, "batched encrypted x plain", expected, 1e-3);
+
+  // For comparison, here's the per-query loop, with one [n, k, *] tensor per
+  // query. Each query fills a tile of its own, its 64 elements duplicated 64
+  // times along the third dim, so this takes 16 tile multiplications where
+  // the batched version, with 8 queries per tile, takes 2.
+  TTShape singleShape({8, 8, 64});
+  singleShape.setOriginalSizes({n, k, 1});
+  singleShape = singleShape.getWithDuplicatedDim(2);
+  TTShape singleWShape({8, 8, 64});
+  singleWShape.setOriginalSizes({1, k, m});
+  singleWShape = singleWShape.getWithDuplicatedDim(0);
+  DoubleTensor singleW = weights.getSlice(3, 0);
+  singleW.reshape({1, k, m});
+  PTileTensor singleWP(he);
+  enc.encode(singleWP, singleWShape, singleW);
+  for (DimInt b = 0; b < batch; ++b) {
+    DoubleTensor q = queries.getSlice(3, b);
+    q.reshape({n, k, 1});
+    CTileTensor qC(he);
+    enc.encodeEncrypt(qC, singleShape, q);
+    HELAYERS_TIMER_PUSH("per query");
+    qC.multiplyPlainAndSum(singleWP, 1);
+    HELAYERS_TIMER_POP();
+  }
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("batched");
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("per query");
+
+  // With a different encrypted matrix per batch item, only the packing of W
+  // changes.
+  DoubleTensor keys({1, k, m, batch});
+  keys.initRandom(-1, 1);
+  DoubleTensor expected2({n, 1, m, batch});
+  for (DimInt b = 0; b < batch; ++b)
+    for (DimInt i = 0; i < n; ++i)
+      for (DimInt j = 0; j < m; ++j)
+        for (DimInt l = 0; l < k; ++l)
+          expected2.at(i, 0, j, b) +=
+              queries.at(i, l, 0, b) * keys.at(0, l, j, b);
+  CTileTensor keysC(he);
+  enc.encodeEncrypt(
+      keysC, getBatchedRightShape(tileSizes, k, m, batch), keys);
+  CTileTensor res2 = batchedMatMul(a, keysC);
+  enc.assertEquals(res2, "batched encrypted x encrypted", expected2, 1e-3);
+
+  cout << "\nBatched matrix multiplication worked correctly!" << endl;
+}